@@ -11,18 +11,261 @@
 #include <algorithm>
 #include <unordered_map>
 #include <numeric>
+#include <functional>
+#include "symbols.h"
+#include "terminal_set.h"
+#include "metrics.h"
 using namespace std;
 
+// One production in the flat rhs pool: lhs -> rhsPool[offset .. offset + length)
+// An ε production is stored with length 0.
+struct Production {
+    SymbolId lhs;
+    int offset;
+    int length;
+};
+
+// Parsing table cell values besides production indices
+const int TABLE_ERROR = -1;     // blank: panic mode skips the input token
+const int TABLE_SYNCH = -2;     // input is in FOLLOW(A): panic mode pops A
+
+// Two productions of one non-terminal competing for a table cell. FirstFirst: the
+// terminal is in FIRST of both; FirstFollow: one of them reaches it through ε and
+// FOLLOW. The later production (incoming) is the one left in the table.
+enum ConflictKind { FirstFirst, FirstFollow };
+
+struct TableConflict {
+    ConflictKind kind;
+    SymbolId nonTerminal;
+    SymbolId terminal;
+    int existing;       // production indices
+    int incoming;
+};
+
+// Shape of the parse table and what it would cost in various layouts
+struct TableStats {
+    int rows = 0, columns = 0;
+    int entries = 0;                // cells holding a production
+    int synchEntries = 0;
+    double density = 0;             // entries / cells
+    SymbolId largestRow = NO_SYMBOL;
+    int largestRowEntries = 0;
+    size_t denseBytes = 0;          // the int table as built
+    size_t dense16Bytes = 0;        // same with 16 bit cells (up to 32767 productions)
+    size_t sparseBytes = 0;         // per row lists of (column, production) pairs
+    size_t compressedBytes = 0;     // row displacement form (CompressedTable)
+    int compressedSlots = 0;
+};
+
+enum class TableLayout { Dense, Compressed };
+
+// Row displacement ("comb vector") form of the parse table for big sparse grammars.
+// Every row keeps its most common cell value as the default and only lists the other
+// cells; the rows are slid over each other into one slot array so that no two listed
+// cells land in the same slot, and each slot remembers which row owns it. Columns are
+// renumbered first, the ones listed by the most rows next to each other, which keeps
+// the rows' combs short. Gives exactly the dense table's cells, error and synch
+// entries included.
+struct CompressedTable {
+    struct Row {
+        int base;           // slot of column 0
+        int defaultValue;   // cell value of every column the row doesn't list
+    };
+    struct Slot {
+        int check;          // owning row, -1 = free
+        int value;
+    };
+
+    vector<Row> rows;
+    vector<int> columnIndex;    // table column -> position within a row
+    vector<Slot> slots;         // padded so base + position is always in range
+
+    int lookup(int row, int column) const {
+        const Row& r = rows[row];
+        const Slot& slot = slots[r.base + columnIndex[column]];
+        return slot.check == row ? slot.value : r.defaultValue;
+    }
+
+    size_t bytes() const {
+        return rows.size() * sizeof(Row) + columnIndex.size() * sizeof(int) + slots.size() * sizeof(Slot);
+    }
+
+    // Packs a dense rowCount x columnCount table
+    static CompressedTable pack(const vector<int>& dense, int rowCount, int columnCount) {
+        return pack(rowCount, columnCount, [&](int row, vector<pair<int, int>>& cells) {
+            for (int column = 0; column < columnCount; column++) {
+                int cell = dense[(size_t)row * columnCount + column];
+                if (cell != TABLE_ERROR) cells.push_back({column, cell});
+            }
+        });
+    }
+
+    // Packs a table that only exists row by row: rowCells(row, cells) appends the (column,
+    // value) pairs of the row's non-error cells, and is called twice per row, once to
+    // count and once to place. Only one row is ever listed at a time, so a big sparse
+    // table is displaced into the slots without existing in any other form. Rows with
+    // the most listed cells go first, each at the lowest base where all of them fit
+    // (first fit)
+    template <typename RowCells>
+    static CompressedTable pack(int rowCount, int columnCount, RowCells rowCells) {
+        CompressedTable table;
+        table.rows.assign(rowCount, {0, TABLE_ERROR});
+        vector<pair<int, int>> cells;
+        vector<char> present;
+        unordered_map<int, int> frequency;
+
+        // The row's cells other than its default: the most common value, or blank
+        auto listRow = [&](int row, bool chooseDefault) {
+            cells.clear();
+            rowCells(row, cells);
+            int& defaultValue = table.rows[row].defaultValue;
+            if (chooseDefault) {
+                frequency.clear();
+                int errors = columnCount - cells.size(), synchs = 0;
+                for (const auto& cell : cells) {
+                    if (cell.second == TABLE_SYNCH) synchs++;
+                    else frequency[cell.second]++;
+                }
+                int best = errors;
+                defaultValue = TABLE_ERROR;
+                if (synchs > best) {
+                    defaultValue = TABLE_SYNCH;
+                    best = synchs;
+                }
+                for (const auto& entry : frequency) {
+                    if (entry.second > best || (entry.second == best && defaultValue >= 0 && entry.first < defaultValue)) {
+                        defaultValue = entry.first;
+                        best = entry.second;
+                    }
+                }
+            }
+            if (defaultValue == TABLE_ERROR) {
+                return;     // the listed cells are exactly the given ones
+            }
+            // A mostly filled row: the error cells have to be listed instead
+            present.assign(columnCount, false);
+            for (const auto& cell : cells) present[cell.first] = true;
+            cells.erase(remove_if(cells.begin(), cells.end(), [&](const pair<int, int>& cell) {
+                return cell.second == defaultValue;
+            }), cells.end());
+            for (int column = 0; column < columnCount; column++) {
+                if (!present[column]) cells.push_back({column, TABLE_ERROR});
+            }
+        };
+
+        vector<int> listedBy(columnCount, 0), byFrequency(columnCount), listedCount(rowCount);
+        for (int row = 0; row < rowCount; row++) {
+            listRow(row, true);
+            listedCount[row] = cells.size();
+            for (const auto& cell : cells) listedBy[cell.first]++;
+        }
+        iota(byFrequency.begin(), byFrequency.end(), 0);
+        stable_sort(byFrequency.begin(), byFrequency.end(), [&](int a, int b) { return listedBy[a] > listedBy[b]; });
+        table.columnIndex.resize(columnCount);
+        for (int position = 0; position < columnCount; position++) {
+            table.columnIndex[byFrequency[position]] = position;
+        }
+
+        vector<int> order(rowCount);
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](int a, int b) { return listedCount[a] > listedCount[b]; });
+
+        // nextFree[i]: the first free slot at or after i (path compressed), so a clash
+        // moves the base straight to where that column could go
+        vector<Slot>& slots = table.slots;
+        vector<int> nextFree(1, 0);
+        auto findFree = [&](int slot) {
+            int root = slot;
+            while (nextFree[root] != root) root = nextFree[root];
+            while (nextFree[slot] != root) {
+                int up = nextFree[slot];
+                nextFree[slot] = root;
+                slot = up;
+            }
+            return root;
+        };
+        for (int row : order) {
+            if (listedCount[row] == 0) {
+                continue;       // base 0, never owns a slot
+            }
+            listRow(row, false);
+            sort(cells.begin(), cells.end(), [&](const pair<int, int>& a, const pair<int, int>& b) {
+                return table.columnIndex[a.first] < table.columnIndex[b.first];
+            });
+            int base = max(0, findFree(0) - table.columnIndex[cells[0].first]);
+            for (bool fits = false; !fits;) {
+                fits = true;
+                for (const auto& cell : cells) {
+                    int position = table.columnIndex[cell.first];
+                    int slot = base + position;
+                    if (slot < (int)slots.size() && slots[slot].check >= 0) {
+                        base = findFree(slot) - position;
+                        fits = false;
+                        break;
+                    }
+                }
+            }
+            if (slots.size() < (size_t)base + columnCount) {
+                int oldSize = slots.size();
+                slots.resize(base + columnCount, {-1, TABLE_ERROR});
+                nextFree.resize(slots.size() + 1);
+                iota(nextFree.begin() + oldSize + 1, nextFree.end(), oldSize + 1);
+            }
+            for (const auto& cell : cells) {
+                int slot = base + table.columnIndex[cell.first];
+                slots[slot] = {row, cell.second};
+                nextFree[slot] = slot + 1;
+            }
+            table.rows[row].base = base;
+        }
+        if (slots.size() < (size_t)columnCount) {
+            slots.resize(columnCount, {-1, TABLE_ERROR});
+        }
+        slots.shrink_to_fit();
+        return table;
+    }
+};
+
 class CFG {
+    friend class GrammarCache;  // reads/writes the analysed grammar as a binary blob
+
 private:
-    map<string, vector<vector<string>>> productions;  
-    map<string, set<string>> firstSets; 
-    map<string, set<string>> followSets; 
-    map<pair<string, string>, vector<string>> parsing_table;
-    string start_symbol;
-    vector<string> nonTerminalOrder;  // Track the original order of non-terminals
+    SymbolTable symbols;    // all symbols are interned here, everything below works on ids
+    map<SymbolId, vector<vector<SymbolId>>> productions;  
+
+    // FIRST/FOLLOW as bitsets over the terminal columns, indexed by table row.
+    // ε is not a column, nullable[row] says whether the non-terminal derives ε
+    vector<TerminalSet> firstSets;
+    vector<TerminalSet> followSets;
+    vector<bool> nullable;
+
+    // LL(1) table, built by constructParsingTable(): a dense [nonterminal x terminal]
+    // array of production indices (-1 = error), productions stored once in rhsPool.
+    // With the compressed layout parsing_table is dropped in favour of compressedTable
+    vector<SymbolId> rhsPool;
+    vector<Production> productionList;
+    vector<int> rowOf;          // symbol id -> table row (-1 if not a non-terminal)
+    vector<int> columnOf;       // symbol id -> table column (-1 if not a terminal)
+    vector<SymbolId> tableRows, tableColumns;
+    vector<int> parsing_table;
+    CompressedTable compressedTable;
+
+    // Size the dense table would pack to, for getTableStats(). Computed on the first
+    // call, after that the (expensive) pack isn't repeated
+    struct PackedSize {
+        bool known = false;
+        size_t bytes = 0;
+        int slots = 0;
+    };
+    mutable PackedSize packedStats;
+    TableLayout tableLayout = TableLayout::Dense;
+    vector<TableConflict> conflicts;    // found by the last constructParsingTable()
+    SymbolId start_symbol = NO_SYMBOL;
+    vector<SymbolId> nonTerminalOrder;  // Track the original order of non-terminals
 
 public:
+    CFG() {}
+
     CFG(const string& filename) {
         read_from_file(filename);
         if (!productions.empty()) {
@@ -30,45 +273,90 @@ public:
         }
     }
 
+    const SymbolTable& getSymbols() const {
+        return symbols;
+    }
+
     string getStartSymbol() const {
+        return symbols.name(start_symbol);
+    }
+
+    SymbolId getStartSymbolId() const {
         return start_symbol;
     }
 
-    vector<string> getParsingTableEntry(const string& nonTerminal, const string& terminal) const {
-        auto key = make_pair(nonTerminal, terminal);
-        if (parsing_table.find(key) != parsing_table.end()) {
-            return parsing_table.at(key);
+    // Returns the production index for (nonTerminal, terminal), TABLE_ERROR if there is no
+    // entry or TABLE_SYNCH if the terminal is a synchronizing token for the non-terminal
+    int getParsingTableEntry(SymbolId nonTerminal, SymbolId terminal) const {
+        if (nonTerminal < 0 || terminal < 0 || nonTerminal >= (int)rowOf.size() || terminal >= (int)columnOf.size()) {
+            return TABLE_ERROR;
+        }
+        int row = rowOf[nonTerminal], column = columnOf[terminal];
+        if (row < 0 || column < 0) {
+            return TABLE_ERROR;
         }
-        return {}; // Return empty vector if no entry found
+        return getTableCell(row, column);
+    }
+
+    // Raw table layout: rows are non-terminals, columns terminals (see constructParsingTable)
+    const vector<SymbolId>& getTableRows() const { return tableRows; }
+    const vector<SymbolId>& getTableColumns() const { return tableColumns; }
+    int getTableCell(int row, int column) const {
+        if (tableLayout == TableLayout::Compressed) {
+            return compressedTable.lookup(row, column);
+        }
+        return parsing_table[row * tableColumns.size() + column];
+    }
+    TableLayout getTableLayout() const { return tableLayout; }
+    int getProductionCount() const { return productionList.size(); }
+
+    const Production& getProduction(int index) const {
+        return productionList[index];
+    }
+
+    // Right hand side of a production, points straight into the rhs pool (empty for ε)
+    SymbolSpan getProductionRhs(int index) const {
+        const Production& prod = productionList[index];
+        return SymbolSpan{rhsPool.data() + prod.offset, prod.length};
+    }
+
+    bool isTerminal(SymbolId symbol) const {
+        return symbols.isTerminal(symbol);
     }
 
     bool isTerminal(const string& symbol) const {
-        return productions.find(symbol) == productions.end() && symbol != "ε";
+        SymbolId id = symbols.lookup(symbol);
+        return id == NO_SYMBOL || symbols.isTerminal(id);
     }
 
     void read_from_file(const string& filename) {
+        METRIC_TIMER("cfg_read_grammar");
         ifstream file(filename);
         string line;
 
         while (getline(file, line)) {
             istringstream read(line);
-            string nonTerminal, arrow, production;
-            read >> nonTerminal >> arrow; // read the non-terminal and arrow "S ->"
+            string name, arrow, production;
+            if (!(read >> name >> arrow)) { // read the non-terminal and arrow "S ->"
+                continue;   // skip blank lines
+            }
+            SymbolId nonTerminal = symbols.intern(name);
+            symbols.setNonTerminal(nonTerminal);
 
             // Add to order list if not already there
             if (find(nonTerminalOrder.begin(), nonTerminalOrder.end(), nonTerminal) == nonTerminalOrder.end()) {
                 nonTerminalOrder.push_back(nonTerminal);
             }
 
-            vector<vector<string>> rules;
-            vector<string> currentRule;
+            vector<vector<SymbolId>> rules;
+            vector<SymbolId> currentRule;
             while (read >> production) {
                 if (production == "|") {    // '|' will mean that a new production rule has started --> save the old one
                     rules.push_back(currentRule);
                     currentRule.clear();
                 } 
                 else {
-                    currentRule.push_back(production);
+                    currentRule.push_back(symbols.intern(production));
                 }
             }
             if (!currentRule.empty()) {
@@ -89,11 +377,11 @@ public:
         // Print in original order using nonTerminalOrder
         for (const auto& nonTerminal : nonTerminalOrder) {
             if (productions.find(nonTerminal) != productions.end()) {
-                cout << nonTerminal << " -> ";
+                cout << symbols.name(nonTerminal) << " -> ";
                 const auto& rules = productions.at(nonTerminal);
                 for (int i = 0; i < rules.size(); i++) {
                     for (const auto& symbol : rules[i]) {
-                        cout << symbol << " ";
+                        cout << symbols.name(symbol) << " ";
                     }
                     if (i != rules.size() - 1) {
                         cout << "| ";
@@ -104,22 +392,68 @@ public:
         }
     }
 
+    // Ordered elimination of direct and indirect left recursion (A1..An in grammar order):
+    // Ai -> Aj γ with j < i gets Aj's alternatives substituted in, then Ai's direct
+    // recursion is removed with a new Ai'. Only non-terminals on a common left corner
+    // cycle are substituted into each other, everything else keeps its shape.
+    // Recursion hidden behind a nullable prefix (A -> B A, B =>* ε) isn't handled.
     void LeftRecursion() {
         if (productions.empty()) {
             return;
         }
-        map<string, vector<vector<string>>> naya_cfg;
-        vector<string> new_order;  // New order of non-terminals
+        METRIC_TIMER("cfg_left_recursion");
+        map<SymbolId, vector<vector<SymbolId>>> naya_cfg;
+        vector<SymbolId> new_order;  // New order of non-terminals
+
+        vector<int> cycle = leftCornerCycles();     // symbol -> left corner SCC
+        vector<int> position(symbols.size(), -1);
+        for (size_t i = 0; i < nonTerminalOrder.size(); i++) {
+            position[nonTerminalOrder[i]] = i;
+        }
 
         for (const auto& non_terminal : nonTerminalOrder) {
             new_order.push_back(non_terminal);  // Keep original non-terminal in order
-            
-            auto& rule = productions.at(non_terminal);
-            vector<vector<string>> recusrive_prod, normal;
+
+            // Substitute earlier non-terminals of the same cycle until every alternative
+            // starts with a terminal, a later non-terminal or non_terminal itself. The
+            // earlier ones are already done, so each step moves strictly forward.
+            vector<vector<SymbolId>> rule = productions.at(non_terminal);
+            for (bool substituted = true; substituted;) {
+                substituted = false;
+                vector<vector<SymbolId>> expanded;
+                for (auto& prod : rule) {
+                    SymbolId head = prod[0];
+                    bool earlier = head != EPSILON && symbols.isNonTerminal(head) && head < (SymbolId)position.size() &&
+                                   position[head] >= 0 && position[head] < position[non_terminal] &&
+                                   cycle[head] == cycle[non_terminal];
+                    if (!earlier) {
+                        expanded.push_back(move(prod));
+                        continue;
+                    }
+                    for (const auto& replacement : naya_cfg.at(head)) {
+                        vector<SymbolId> combined;
+                        if (replacement[0] != EPSILON) {
+                            combined = replacement;
+                        }
+                        combined.insert(combined.end(), prod.begin() + 1, prod.end());
+                        if (combined.empty()) {
+                            combined.push_back(EPSILON);
+                        }
+                        expanded.push_back(move(combined));
+                    }
+                    substituted = true;
+                }
+                rule = move(expanded);
+            }
+
+            vector<vector<SymbolId>> recusrive_prod, normal;
 
             for (auto& prod : rule) {
                 if (!prod.empty() && prod[0] == non_terminal) { // if left recursion ---> save to recusrive_prod
-                    recusrive_prod.push_back(vector<string>(prod.begin() + 1, prod.end()));
+                    if (prod.size() == 1) {
+                        continue;   // A -> A adds nothing
+                    }
+                    recusrive_prod.push_back(vector<SymbolId>(prod.begin() + 1, prod.end()));
                 } else {
                     normal.push_back(prod);
                 }
@@ -129,10 +463,13 @@ public:
                 naya_cfg[non_terminal] = rule;
             } 
             else {
-                string new_nonTerminal = non_terminal + "'";
+                SymbolId new_nonTerminal = freshNonTerminal(symbols.name(non_terminal) + "'");
                 new_order.push_back(new_nonTerminal);  // Add new non-terminal to order
 
                 for (auto& prod : normal) {
+                    if (prod[0] == EPSILON) {
+                        prod.clear();       // A -> ε becomes A -> A'
+                    }
                     prod.push_back(new_nonTerminal);
                     naya_cfg[non_terminal].push_back(prod);
                 }
@@ -141,7 +478,7 @@ public:
                     prod.push_back(new_nonTerminal);
                     naya_cfg[new_nonTerminal].push_back(prod);
                 }
-                naya_cfg[new_nonTerminal].push_back({"ε"});
+                naya_cfg[new_nonTerminal].push_back({EPSILON});
             }
         }
 
@@ -149,53 +486,62 @@ public:
         nonTerminalOrder = new_order;  // Update the order
     }
 
+    // Factors out the longest common prefix of every set of alternatives. Each
+    // non-terminal's productions go into a trie; a chain of single child nodes becomes
+    // one shared prefix and every branching node a new X_Fn whose alternatives are the
+    // branches. All alternatives of a non-terminal end up starting with different
+    // symbols, so one pass already is the fixed point, and the work is linear in the
+    // size of the grammar. Duplicate alternatives collapse into one.
     void LeftFactoring() {
         if (productions.empty()) {
             return;
         }
-        map<string, vector<vector<string>>> naya_cfg;
-        vector<string> new_order;  // New order of non-terminals
+        METRIC_TIMER("cfg_left_factoring");
+        map<SymbolId, vector<vector<SymbolId>>> naya_cfg;
+        vector<SymbolId> new_order;  // New order of non-terminals
         int new_nonterm_count = 1;
 
         for (const auto& non_terminal : nonTerminalOrder) {
             new_order.push_back(non_terminal);  // Keep original non-terminal in order
-            
-            const vector<vector<string>>& prods = productions.at(non_terminal);
-            map<string, vector<vector<string>>> grouped_prods;
-
-            for (int i = 0; i < prods.size(); i++) {
-                string prefix = prods[i][0];
 
-                for (int j = i + 1; j < prods.size(); j++) {
-                    if (prods[j][0] == prefix) {
-                        grouped_prods[prefix].push_back(prods[j]); // if productions have the same lhs, add to grouped
-                    }
-                }
-                grouped_prods[prefix].push_back(prods[i]);
+            PrefixTrie trie;
+            for (const vector<SymbolId>& prod : productions.at(non_terminal)) {
+                trie.insert(prod);
             }
 
-            for (const auto& group : grouped_prods) {
-                string prefix = group.first;    // the common lhs wala part
-                const vector<vector<string>>& groupProds = group.second;    // the productions that share it
+            // Emits the alternatives below node as productions of lhs
+            function<void(int, SymbolId)> emit = [&](int node, SymbolId lhs) {
+                for (SymbolId first : trie.nodes[node].order) {
+                    if (first == EPSILON) {
+                        naya_cfg[lhs].push_back({EPSILON});
+                        continue;
+                    }
+                    vector<SymbolId> prefix = {first};
+                    int current = trie.nodes[node].children.at(first);
+                    while (trie.nodes[current].order.size() == 1 && trie.nodes[current].order[0] != EPSILON) {
+                        SymbolId next = trie.nodes[current].order[0];
+                        prefix.push_back(next);
+                        current = trie.nodes[current].children.at(next);
+                    }
 
-                if (groupProds.size() == 1) {
-                    naya_cfg[non_terminal].push_back(groupProds[0]);    
-                } 
-                else {
-                    string factored_nt = non_terminal + "_F" + to_string(new_nonterm_count++);
+                    if (trie.nodes[current].order.size() == 1) {    // just the end: a whole production
+                        naya_cfg[lhs].push_back(prefix);
+                        continue;
+                    }
+                    // Skip every name already in use, terminals included (S -> a S_F1 | a b)
+                    string factored_name;
+                    do {
+                        factored_name = symbols.name(non_terminal) + "_F" + to_string(new_nonterm_count++);
+                    } while (symbols.lookup(factored_name) != NO_SYMBOL);
+                    SymbolId factored_nt = freshNonTerminal(factored_name);
                     new_order.push_back(factored_nt);  // Add new factored non-terminal to order
-                    
-                    naya_cfg[non_terminal].push_back({prefix, factored_nt});
 
-                    for (const vector<string>& prod : groupProds) {
-                        vector<string> suffix(prod.begin() + 1, prod.end());
-                        if (suffix.empty()) {
-                            suffix.push_back("ε");
-                        }
-                        naya_cfg[factored_nt].push_back(suffix);
-                    }
+                    prefix.push_back(factored_nt);
+                    naya_cfg[lhs].push_back(prefix);
+                    emit(current, factored_nt);
                 }
-            }
+            };
+            emit(0, non_terminal);
         }
 
         productions = naya_cfg;
@@ -206,195 +552,353 @@ public:
         if (productions.empty()) {
             return;
         }
+        METRIC_TIMER("cfg_first_sets");
 
-        // Initialize FIRST sets for all terminals and non-terminals
-        for (const auto& rule : productions) {
-            string non_terminal = rule.first;
-            firstSets[non_terminal] = {};
-            
-            // Check for empty productions and add epsilon
-            for (const auto& production : rule.second) {
-                if (production.size() == 1 && production[0] == "ε") {
-                    firstSets[non_terminal].insert("ε");
-                    break;
+        // Terminals and non-terminals get their dense row/column numbers here, the
+        // sets below are bitsets over the columns
+        indexSymbols();
+        int rows = tableRows.size();
+        nullable.assign(rows, false);
+        firstSets.assign(rows, TerminalSet(tableColumns.size()));
+
+        // Nullable: a production becomes nullable when all of its symbols are, so keep a
+        // counter of not-yet-nullable symbols per production and only revisit the
+        // productions that use a non-terminal when it turns nullable
+        vector<pair<int, int>> prodRefs;                // (row of lhs, remaining symbols)
+        vector<vector<int>> usedIn(rows);               // row -> productions it occurs in (once per occurrence)
+        vector<int> worklist;
+
+        for (SymbolId nonTerminal : nonTerminalOrder) {
+            int row = rowOf[nonTerminal];
+            for (const auto& production : productions[nonTerminal]) {
+                int prod = prodRefs.size();
+                int remaining = 0;
+                for (SymbolId symbol : production) {
+                    if (symbol == EPSILON) {
+                        continue;
+                    }
+                    remaining++;
+                    if (!isTerminal(symbol)) {
+                        usedIn[rowOf[symbol]].push_back(prod);
+                    }
+                }
+                prodRefs.push_back({row, remaining});
+                if (remaining == 0 && !nullable[row]) {
+                    nullable[row] = true;
+                    worklist.push_back(row);
                 }
             }
         }
 
-        bool changed = true;
-
-        while (changed) {
-            changed = false;
-
-            for (const auto& rule : productions) {
-                string non_terminal = rule.first;
+        while (!worklist.empty()) {
+            int row = worklist.back();
+            worklist.pop_back();
+            for (int prod : usedIn[row]) {
+                int lhs = prodRefs[prod].first;
+                if (--prodRefs[prod].second == 0 && !nullable[lhs]) {
+                    nullable[lhs] = true;
+                    worklist.push_back(lhs);
+                }
+            }
+        }
 
-                for (const auto& production : rule.second) {
-                    // Handle empty production explicitly
-                    if (production.size() == 1 && production[0] == "ε") {
-                        if (firstSets[non_terminal].insert("ε").second)
-                            changed = true;
+        // FIRST: terminals at the start of a production go in directly, and FIRST(A) depends
+        // on FIRST(X) for every non-terminal X that can start A -> ... X ...
+        vector<vector<int>> dependents(rows);           // row X -> rows A with FIRST(A) ⊇ FIRST(X)
+        for (SymbolId nonTerminal : nonTerminalOrder) {
+            int row = rowOf[nonTerminal];
+            for (const auto& production : productions[nonTerminal]) {
+                for (SymbolId symbol : production) {
+                    if (symbol == EPSILON) {
                         continue;
                     }
-
-                    // Handle regular productions
-                    bool allDeriveEpsilon = true;
-                    for (size_t i = 0; i < production.size(); i++) {
-                        string symbol = production[i];
-                        
-                        if (isTerminal(symbol)) {
-                            if (firstSets[non_terminal].insert(symbol).second)
-                                changed = true;
-                            allDeriveEpsilon = false;
-                            break;
-                        } 
-                        else { // Symbol is a non-terminal
-                            // Add all non-epsilon symbols from FIRST(symbol) to FIRST(non_terminal)
-                            for (const auto& first : firstSets[symbol]) {
-                                if (first != "ε") {
-                                    if (firstSets[non_terminal].insert(first).second)
-                                        changed = true;
-                                }
-                            }
-                            
-                            // If this symbol doesn't derive epsilon, stop here
-                            if (firstSets[symbol].count("ε") == 0) {
-                                allDeriveEpsilon = false;
-                                break;
-                            }
-                            
-                            // If this is the last symbol and it derives epsilon, add epsilon to FIRST(non_terminal)
-                            if (i == production.size() - 1 && firstSets[symbol].count("ε") > 0) {
-                                if (firstSets[non_terminal].insert("ε").second)
-                                    changed = true;
-                            }
-                        }
+                    if (isTerminal(symbol)) {
+                        firstSets[row].insert(columnOf[symbol]);
+                        break;
                     }
-                    
-                    // If all symbols in the production derive epsilon, add epsilon to FIRST(non_terminal)
-                    if (allDeriveEpsilon && production.size() > 0) {
-                        if (firstSets[non_terminal].insert("ε").second)
-                            changed = true;
+                    if (rowOf[symbol] != row) {
+                        dependents[rowOf[symbol]].push_back(row);
+                    }
+                    if (!nullable[rowOf[symbol]]) {
+                        break;
                     }
                 }
             }
         }
+        propagate(firstSets, dependents);
     }
 
     void computeFollowSets() {
         if (productions.empty()) {
             return;
         }
+        METRIC_TIMER("cfg_follow_sets");
         
-        // Initialize all FOLLOW sets
-        for (const auto& rule : productions) {
-            followSets[rule.first] = {};
-        }
+        int rows = tableRows.size();
+        followSets.assign(rows, TerminalSet(tableColumns.size()));
         
         // Add $ to FOLLOW(start_symbol)
-        followSets[start_symbol].insert("$");
-
-        bool changed = true;
-        while (changed) {
-            changed = false;
+        followSets[rowOf[start_symbol]].insert(columnOf[END_MARKER]);
 
-            for (const auto& rule : productions) {
-                string nonTerminal = rule.first;
+        // Walk every production right to left keeping FIRST of the suffix seen so far.
+        // FOLLOW(X) gets that directly, and if the suffix can vanish FOLLOW(X) also
+        // depends on FOLLOW(lhs), which is left to the worklist
+        vector<vector<int>> dependents(rows);           // row A -> rows X with FOLLOW(X) ⊇ FOLLOW(A)
+        TerminalSet trailer(tableColumns.size());
+        for (SymbolId nonTerminal : nonTerminalOrder) {
+            int row = rowOf[nonTerminal];
+            for (const auto& production : productions[nonTerminal]) {
+                trailer.clear();
+                bool trailerNullable = true;
 
-                for (const auto& production : rule.second) {
-                    // Skip epsilon productions
-                    if (production.size() == 1 && production[0] == "ε") {
+                for (int i = production.size() - 1; i >= 0; i--) {
+                    SymbolId symbol = production[i];
+                    if (symbol == EPSILON) {
                         continue;
                     }
-                    
-                    for (int i = 0; i < production.size(); i++) {
-                        string symbol = production[i];
-
-                        // Only interested in non-terminals
-                        if (!isTerminal(symbol)) {
-                            // Case 1: symbol is followed by another symbol
-                            if (i + 1 < production.size()) {
-                                string nextSymbol = production[i + 1];
-                                
-                                if (isTerminal(nextSymbol)) {
-                                    // If nextSymbol is a terminal, add it to FOLLOW(symbol)
-                                    if (followSets[symbol].insert(nextSymbol).second)
-                                        changed = true;
-                                } 
-                                else {
-                                    // If nextSymbol is a non-terminal, add FIRST(nextSymbol) - {ε} to FOLLOW(symbol)
-                                    for (const auto& first : firstSets[nextSymbol]) {
-                                        if (first != "ε") {
-                                            if (followSets[symbol].insert(first).second)
-                                                changed = true;
-                                        }
-                                    }
-                                    
-                                    // If nextSymbol can derive epsilon, need to consider what comes after it
-                                    if (firstSets[nextSymbol].count("ε") > 0) {
-                                        // Add FOLLOW(nonTerminal) to FOLLOW(symbol)
-                                        for (const auto& follow : followSets[nonTerminal]) {
-                                            if (followSets[symbol].insert(follow).second)
-                                                changed = true;
-                                        }
-                                    }
-                                }
-                            } 
-                            // Case 2: symbol is at the end of the production
-                            else {
-                                // Add FOLLOW(nonTerminal) to FOLLOW(symbol)
-                                for (const auto& follow : followSets[nonTerminal]) {
-                                    if (followSets[symbol].insert(follow).second)
-                                        changed = true;
-                                }
-                            }
-                        }
+                    if (isTerminal(symbol)) {
+                        trailer.clear();
+                        trailer.insert(columnOf[symbol]);
+                        trailerNullable = false;
+                        continue;
+                    }
+
+                    int symbolRow = rowOf[symbol];
+                    followSets[symbolRow].unionWith(trailer);
+                    if (trailerNullable && symbolRow != row) {
+                        dependents[row].push_back(symbolRow);
                     }
+
+                    if (!nullable[symbolRow]) {
+                        trailer.clear();
+                        trailerNullable = false;
+                    }
+                    trailer.unionWith(firstSets[symbolRow]);
                 }
             }
         }
+        propagate(followSets, dependents);
     }
 
-    void constructParsingTable() {
+    // Builds the table in the requested layout. Compressed is meant for big generated
+    // grammars where most cells are blank (see printTableStats): then only the production
+    // cells of each row are kept, the synch cells come from FOLLOW again while packing,
+    // and the dense table never exists
+    void constructParsingTable(TableLayout layout = TableLayout::Dense) {
         if (productions.empty()) {
             return;
         }
+        METRIC_TIMER("cfg_parsing_table");
         
-        // Clear the parsing table first
-        parsing_table.clear();
+        // Clear the parsing table first (rows/columns were assigned by computeFirstSets)
+        rhsPool.clear();
+        productionList.clear();
+        conflicts.clear();
+        compressedTable = CompressedTable();
+        packedStats = {};
+        tableLayout = layout;
+        bool dense = layout == TableLayout::Dense;
+        vector<vector<pair<int, int>>> productionCells;    // compressed: (column, production) by row
+        if (dense) {
+            parsing_table.assign(tableRows.size() * tableColumns.size(), TABLE_ERROR);
+        } else {
+            vector<int>().swap(parsing_table);
+            productionCells.resize(tableRows.size());
+        }
+        TerminalSet prodFirst(tableColumns.size());
+
+        // Every production that claimed a cell of the current row, and whether it got
+        // there through FOLLOW. Cells are only ever claimed by their own row's productions,
+        // so this is reset per row and only the touched columns need clearing
+        vector<vector<pair<int, bool>>> claims(tableColumns.size());
+        vector<int> claimedColumns;
+
+        // Later productions win a contested cell (as they always did), but the clash with
+        // every earlier claimant is recorded
+        auto place = [&](SymbolId nonTerminal, int column, int index, bool fromFollow) {
+            vector<pair<int, bool>>& cellClaims = claims[column];
+            if (cellClaims.empty()) {
+                claimedColumns.push_back(column);
+            }
+            if (!cellClaims.empty() && cellClaims.back().first == index) {
+                return;     // in both FIRST and FOLLOW, the clashes were recorded the first time
+            }
+            for (const auto& claim : cellClaims) {
+                ConflictKind kind = fromFollow || claim.second ? FirstFollow : FirstFirst;
+                conflicts.push_back({kind, nonTerminal, tableColumns[column], claim.first, index});
+            }
+            cellClaims.push_back({index, fromFollow});
+        };
         
         // For each production rule
-        for (const auto& rule : productions) {
-            string nonTerminal = rule.first;
-
-            for (const auto& production : rule.second) {
-                // Handle epsilon production specially
-                if (production.size() == 1 && production[0] == "ε") {
-                    // For each terminal in FOLLOW(nonTerminal), add this epsilon production
-                    for (const string& follow : followSets[nonTerminal]) {
-                        parsing_table[{nonTerminal, follow}] = {"ε"};
-                    }
-                    continue;
+        for (SymbolId nonTerminal : nonTerminalOrder) {
+            int row = rowOf[nonTerminal];
+
+            for (const auto& production : productions[nonTerminal]) {
+                // Store the production once in the flat pool
+                int index = productionList.size();
+                bool isEpsilon = production.size() == 1 && production[0] == EPSILON;
+                productionList.push_back({nonTerminal, (int)rhsPool.size(), isEpsilon ? 0 : (int)production.size()});
+                if (!isEpsilon) {
+                    rhsPool.insert(rhsPool.end(), production.begin(), production.end());
                 }
-                
-                // For non-epsilon productions, compute FIRST set of the production
-                set<string> prodFirst = getProductionFirstSet(production);
-                
+
                 // For each terminal in FIRST(production), add this production
-                for (const string& terminal : prodFirst) {
-                    if (terminal != "ε") {
-                        parsing_table[{nonTerminal, terminal}] = production;
+                bool derivesEpsilon = getProductionFirstSet(production, prodFirst);
+                prodFirst.forEach([&](int column) {
+                    place(nonTerminal, column, index, false);
+                });
+                
+                // If FIRST(production) contains epsilon (or it is the ε production itself),
+                // add this production for each terminal in FOLLOW(nonTerminal)
+                if (derivesEpsilon) {
+                    followSets[row].forEach([&](int column) {
+                        place(nonTerminal, column, index, true);
+                    });
+                }
+            }
+
+            // The last claimant keeps the cell. Panic mode: blank cells under
+            // FOLLOW(nonTerminal) become synch entries, on those the parser pops the
+            // non-terminal instead of skipping input
+            for (int column : claimedColumns) {
+                int index = claims[column].back().first;
+                if (dense) {
+                    parsing_table[(size_t)row * tableColumns.size() + column] = index;
+                } else {
+                    productionCells[row].push_back({column, index});
+                }
+            }
+            if (dense) {
+                followSets[row].forEach([&](int column) {
+                    if (claims[column].empty()) {
+                        parsing_table[(size_t)row * tableColumns.size() + column] = TABLE_SYNCH;
                     }
+                });
+            }
+            for (int column : claimedColumns) {
+                claims[column].clear();
+            }
+            claimedColumns.clear();
+        }
+
+        if (!dense) {
+            vector<char> claimed(tableColumns.size(), false);
+            compressedTable = CompressedTable::pack(tableRows.size(), tableColumns.size(),
+                                                    [&](int row, vector<pair<int, int>>& cells) {
+                for (const auto& cell : productionCells[row]) {
+                    cells.push_back(cell);
+                    claimed[cell.first] = true;
                 }
-                
-                // If FIRST(production) contains epsilon, add this production for each terminal in FOLLOW(nonTerminal)
-                if (prodFirst.count("ε") > 0) {
-                    for (const string& follow : followSets[nonTerminal]) {
-                        parsing_table[{nonTerminal, follow}] = production;
+                followSets[row].forEach([&](int column) {
+                    if (!claimed[column]) cells.push_back({column, TABLE_SYNCH});
+                });
+                for (const auto& cell : productionCells[row]) {
+                    claimed[cell.first] = false;
+                }
+            });
+        }
+        METRIC_SET("cfg_table_cells", tableRows.size() * tableColumns.size());
+        METRIC_SET("cfg_productions", productionList.size());
+        METRIC_SET("cfg_conflicts", conflicts.size());
+        setTableLayout(layout);     // already in it, just records the size
+    }
+
+    // Converts the built table between the dense and the compressed form (same cells)
+    void setTableLayout(TableLayout layout) {
+        if (layout != tableLayout && !productionList.empty()) {
+            int rows = tableRows.size(), columns = tableColumns.size();
+            if (layout == TableLayout::Compressed) {
+                compressedTable = CompressedTable::pack(parsing_table, rows, columns);
+                vector<int>().swap(parsing_table);
+            } else {
+                packedStats = {true, compressedTable.bytes(), (int)compressedTable.slots.size()};
+                parsing_table.resize((size_t)rows * columns);
+                for (int row = 0; row < rows; row++) {
+                    for (int column = 0; column < columns; column++) {
+                        parsing_table[(size_t)row * columns + column] = compressedTable.lookup(row, column);
                     }
                 }
+                compressedTable = CompressedTable();
+            }
+            tableLayout = layout;
+        }
+        METRIC_SET("cfg_table_bytes", tableLayout == TableLayout::Compressed ? compressedTable.bytes()
+                                                                             : parsing_table.size() * sizeof(int));
+    }
+
+    // Conflicts of the last constructParsingTable(), empty for an LL(1) grammar
+    const vector<TableConflict>& getConflicts() const {
+        return conflicts;
+    }
+
+    bool isLL1() const {
+        return conflicts.empty();
+    }
+
+    void printConflicts() const {
+        if (conflicts.empty()) {
+            cout << "\033[32mNo LL(1) conflicts.\033[0m\n";
+            return;
+        }
+        for (const TableConflict& conflict : conflicts) {
+            // With three or more claimants only the last one keeps the cell
+            bool keptIncoming = getParsingTableEntry(conflict.nonTerminal, conflict.terminal) == conflict.incoming;
+            cout << "\033[33mConflict (" << (conflict.kind == FirstFirst ? "FIRST/FIRST" : "FIRST/FOLLOW") << ") at ["
+                 << symbols.name(conflict.nonTerminal) << ", " << symbols.name(conflict.terminal) << "]: "
+                 << productionToString(conflict.existing) << "vs " << productionToString(conflict.incoming)
+                 << (keptIncoming ? "(kept the latter)" : "(both lost to a later production)") << "\033[0m\n";
+        }
+        cout << "\033[33m" << conflicts.size() << " conflict(s), the grammar is not LL(1).\033[0m\n";
+    }
+
+    TableStats getTableStats() const {
+        TableStats stats;
+        stats.rows = tableRows.size();
+        stats.columns = tableColumns.size();
+        for (int row = 0; row < stats.rows; row++) {
+            int rowEntries = 0;
+            for (int column = 0; column < stats.columns; column++) {
+                int cell = getTableCell(row, column);
+                if (cell >= 0) rowEntries++;
+                if (cell == TABLE_SYNCH) stats.synchEntries++;
+            }
+            stats.entries += rowEntries;
+            if (rowEntries > stats.largestRowEntries) {
+                stats.largestRowEntries = rowEntries;
+                stats.largestRow = tableRows[row];
             }
         }
+        size_t cells = (size_t)stats.rows * stats.columns;
+        stats.density = cells ? double(stats.entries + stats.synchEntries) / cells : 0;
+        stats.denseBytes = cells * sizeof(int);
+        stats.dense16Bytes = cells * sizeof(int16_t);
+        stats.sparseBytes = (stats.rows + 1) * sizeof(int) + (stats.entries + stats.synchEntries) * 2 * sizeof(int);
+        if (tableLayout == TableLayout::Compressed) {
+            stats.compressedBytes = compressedTable.bytes();
+            stats.compressedSlots = compressedTable.slots.size();
+        } else if (!parsing_table.empty()) {
+            if (!packedStats.known) {
+                CompressedTable packed = CompressedTable::pack(parsing_table, stats.rows, stats.columns);
+                packedStats = {true, packed.bytes(), (int)packed.slots.size()};
+            }
+            stats.compressedBytes = packedStats.bytes;
+            stats.compressedSlots = packedStats.slots;
+        }
+        return stats;
+    }
+
+    void printTableStats() const {
+        TableStats stats = getTableStats();
+        cout << "Table: " << stats.rows << " x " << stats.columns << ", " << stats.entries << " production entries + "
+             << stats.synchEntries << " synch, density " << fixed << setprecision(1) << stats.density * 100 << "%\n";
+        cout << defaultfloat;
+        if (stats.largestRow != NO_SYMBOL) {
+            cout << "Largest row: " << symbols.name(stats.largestRow) << " (" << stats.largestRowEntries << " productions)\n";
+        }
+        cout << "Memory: dense " << stats.denseBytes << " B, dense 16-bit " << stats.dense16Bytes
+             << " B, sparse rows " << stats.sparseBytes << " B, compressed " << stats.compressedBytes << " B ("
+             << stats.compressedSlots << " slots)" << (tableLayout == TableLayout::Compressed ? ", in use" : "") << "\n";
     }
 
     void printFirstSets() {
@@ -402,17 +906,9 @@ public:
             cout << "\033[0;31mError: No CFG found!\033[0m" << endl;
             return;
         }
-        for (const auto& entry : firstSets) {
-            cout << "FIRST(" << entry.first << ") = { ";
-            int count = 0;
-            int setSize = entry.second.size();
-            
-            for (const auto& symbol : entry.second) {
-                cout << symbol;
-                if (++count < setSize) { // comma for sab except the last element
-                    cout << ", ";
-                }
-            }
+        for (size_t row = 0; row < firstSets.size(); row++) {
+            cout << "FIRST(" << symbols.name(tableRows[row]) << ") = { ";
+            printSet(firstSets[row], nullable[row]);
             cout << "}\n";
         }
     }
@@ -422,17 +918,9 @@ public:
             cout << "\033[0;31mError: No CFG found!\033[0m" << endl;
             return;
         }
-        for (const auto& entry : followSets) {
-            cout << "FOLLOW(" << entry.first << ") = { ";
-            int count = 0;
-            int setSize = entry.second.size();
-            
-            for (const auto& symbol : entry.second) {
-                cout << symbol;
-                if (++count < setSize) { 
-                    cout << ", ";
-                }
-            }
+        for (size_t row = 0; row < followSets.size(); row++) {
+            cout << "FOLLOW(" << symbols.name(tableRows[row]) << ") = { ";
+            printSet(followSets[row], false);
             cout << "}\n";
         }
     }
@@ -443,11 +931,23 @@ public:
             return;
         }
     
-        // Collect all non-terminals and terminals
-        set<string> terminals, non_terminals;
-        for (const auto& entry : parsing_table) {
-            non_terminals.insert(entry.first.first);
-            terminals.insert(entry.first.second);
+        // Collect all non-terminals and terminals that have at least one entry
+        vector<SymbolId> terminals, non_terminals;
+        for (size_t column = 0; column < tableColumns.size(); column++) {
+            for (size_t row = 0; row < tableRows.size(); row++) {
+                if (getTableCell(row, column) >= 0) {
+                    terminals.push_back(tableColumns[column]);
+                    break;
+                }
+            }
+        }
+        for (size_t row = 0; row < tableRows.size(); row++) {
+            for (size_t column = 0; column < tableColumns.size(); column++) {
+                if (getTableCell(row, column) >= 0) {
+                    non_terminals.push_back(tableRows[row]);
+                    break;
+                }
+            }
         }
     
         // Calculate appropriate column width
@@ -465,8 +965,8 @@ public:
         // Print column headers
         cout << left << setw(nonterm_width) << "NON-TERMINAL";
         cout << "|";
-        for (const string& terminal : terminals) {
-            cout << setw(term_width) << terminal << "|";
+        for (SymbolId terminal : terminals) {
+            cout << setw(term_width) << symbols.name(terminal) << "|";
         }
         cout << endl;
         
@@ -478,18 +978,16 @@ public:
         cout << "+" << endl;
         
         // Print table contents
-        for (const string& nt : non_terminals) {
-            cout << left << setw(nonterm_width) << nt << "|";
+        for (SymbolId nt : non_terminals) {
+            cout << left << setw(nonterm_width) << symbols.name(nt) << "|";
             
-            for (const string& t : terminals) {
-                auto key = make_pair(nt, t);
+            for (SymbolId t : terminals) {
+                int index = getParsingTableEntry(nt, t);
                 
-                if (parsing_table.find(key) != parsing_table.end()) {
-                    string production = nt + " -> ";
-                    for (const string& symbol : parsing_table.at(key)) {
-                        production += symbol + " ";
-                    }
-                    cout << setw(term_width) << production;
+                if (index >= 0) {
+                    cout << setw(term_width) << productionToString(index);
+                } else if (index == TABLE_SYNCH) {
+                    cout << setw(term_width) << "synch";
                 } else {
                     cout << setw(term_width) << " ";
                 }
@@ -501,50 +999,199 @@ public:
         // Print footer
         cout << string(total_width, '=') << endl;
     }
+
+    // "A -> x y " style string for display, ε productions print as "A -> ε "
+    string productionToString(int index) const {
+        const Production& prod = productionList[index];
+        string result = symbols.name(prod.lhs) + " -> ";
+        if (prod.length == 0) {
+            return result + "ε ";
+        }
+        for (SymbolId symbol : getProductionRhs(index)) {
+            result += symbols.name(symbol) + " ";
+        }
+        return result;
+    }
     
     private:
-    set<string> getProductionFirstSet(const vector<string>& production) {
-        set<string> result;
-        
-        // Empty production directly yields epsilon
-        if (production.empty() || (production.size() == 1 && production[0] == "ε")) {
-            result.insert("ε");
-            return result;
+    // Productions of one non-terminal sharing prefixes. Children are kept in order of
+    // first appearance, EPSILON in a node's order marks a production ending there.
+    struct PrefixTrie {
+        struct Node {
+            unordered_map<SymbolId, int> children;
+            vector<SymbolId> order;
+        };
+        vector<Node> nodes = vector<Node>(1);
+
+        void insert(const vector<SymbolId>& production) {
+            int node = 0;
+            for (SymbolId symbol : production) {
+                if (symbol == EPSILON) {
+                    continue;
+                }
+                auto it = nodes[node].children.find(symbol);
+                if (it == nodes[node].children.end()) {
+                    nodes[node].children[symbol] = nodes.size();
+                    nodes[node].order.push_back(symbol);
+                    node = nodes.size();
+                    nodes.emplace_back();
+                } else {
+                    node = it->second;
+                }
+            }
+            if (find(nodes[node].order.begin(), nodes[node].order.end(), EPSILON) == nodes[node].order.end()) {
+                nodes[node].order.push_back(EPSILON);
+            }
         }
+    };
 
-        // Calculate FIRST set for the production
-        bool allCanDeriveEpsilon = true;
-        
-        for (const string& symbol : production) {
-            // If it's a terminal, add it and we're done
-            if (isTerminal(symbol)) {
-                result.insert(symbol);
-                allCanDeriveEpsilon = false;
-                break;
-            } 
-            else {
-                // Add all non-epsilon symbols from FIRST(symbol)
-                for (const auto& first : firstSets[symbol]) {
-                    if (first != "ε") {
-                        result.insert(first);
+    // New non-terminal called name, with more primes if that name is taken
+    SymbolId freshNonTerminal(string name) {
+        while (symbols.lookup(name) != NO_SYMBOL) {
+            name += "'";
+        }
+        SymbolId id = symbols.intern(name);
+        symbols.setNonTerminal(id);
+        return id;
+    }
+
+    // Strongly connected components of the left corner graph (A -> B when some
+    // alternative of A starts with B), by symbol id. Two non-terminals can only be
+    // left recursive through each other when they share a component.
+    vector<int> leftCornerCycles() const {
+        int count = symbols.size();
+        vector<vector<SymbolId>> edges(count);
+        for (const auto& entry : productions) {
+            for (const auto& prod : entry.second) {
+                if (!prod.empty() && prod[0] != EPSILON && symbols.isNonTerminal(prod[0]) && productions.count(prod[0])) {
+                    edges[entry.first].push_back(prod[0]);
+                }
+            }
+        }
+
+        // Iterative Tarjan, grammars can be deep enough to overflow a recursive one
+        vector<int> component(count, -1), index(count, -1), low(count, 0);
+        vector<bool> onStack(count, false);
+        vector<SymbolId> stack;
+        vector<pair<SymbolId, size_t>> calls;
+        int nextIndex = 0, components = 0;
+        for (const auto& entry : productions) {
+            if (index[entry.first] >= 0) {
+                continue;
+            }
+            calls.push_back({entry.first, 0});
+            while (!calls.empty()) {
+                SymbolId node = calls.back().first;
+                size_t& edge = calls.back().second;
+                if (edge == 0) {
+                    index[node] = low[node] = nextIndex++;
+                    stack.push_back(node);
+                    onStack[node] = true;
+                }
+                if (edge < edges[node].size()) {
+                    SymbolId next = edges[node][edge++];
+                    if (index[next] < 0) {
+                        calls.push_back({next, 0});
+                    } else if (onStack[next]) {
+                        low[node] = min(low[node], index[next]);
                     }
+                    continue;
                 }
-                
-                // If this symbol doesn't derive epsilon, we stop here
-                if (firstSets[symbol].count("ε") == 0) {
-                    allCanDeriveEpsilon = false;
-                    break;
+                if (low[node] == index[node]) {
+                    SymbolId member;
+                    do {
+                        member = stack.back();
+                        stack.pop_back();
+                        onStack[member] = false;
+                        component[member] = components;
+                    } while (member != node);
+                    components++;
+                }
+                calls.pop_back();
+                if (!calls.empty()) {
+                    low[calls.back().first] = min(low[calls.back().first], low[node]);
                 }
             }
         }
-        
-        // If all symbols can derive epsilon, add epsilon to the result
-        if (allCanDeriveEpsilon) {
-            result.insert("ε");
+        return component;
+    }
+
+    // Assigns table rows to non-terminals (grammar order) and columns to terminals ($ included)
+    void indexSymbols() {
+        tableRows.clear();
+        tableColumns.clear();
+        rowOf.assign(symbols.size(), -1);
+        columnOf.assign(symbols.size(), -1);
+        for (SymbolId nt : nonTerminalOrder) {
+            rowOf[nt] = tableRows.size();
+            tableRows.push_back(nt);
         }
+        for (SymbolId id = 0; id < symbols.size(); id++) {
+            if (symbols.isTerminal(id)) {
+                columnOf[id] = tableColumns.size();
+                tableColumns.push_back(id);
+            }
+        }
+    }
 
-        return result;
+    // Pushes set unions along the dependency edges until nothing changes. Only rows
+    // whose set actually grew are put back on the worklist.
+    void propagate(vector<TerminalSet>& sets, const vector<vector<int>>& dependents) {
+        vector<int> worklist;
+        vector<bool> queued(sets.size(), true);
+        for (int row = sets.size() - 1; row >= 0; row--) {
+            worklist.push_back(row);
+        }
+
+        while (!worklist.empty()) {
+            int row = worklist.back();
+            worklist.pop_back();
+            queued[row] = false;
+            for (int dependent : dependents[row]) {
+                if (sets[dependent].unionWith(sets[row]) && !queued[dependent]) {
+                    queued[dependent] = true;
+                    worklist.push_back(dependent);
+                }
+            }
+        }
+    }
+
+    void printSet(const TerminalSet& set, bool withEpsilon) const {
+        int count = 0;
+        int setSize = set.count() + (withEpsilon ? 1 : 0);
+        auto printOne = [&](const string& name) {
+            cout << name;
+            if (++count < setSize) { // comma for sab except the last element
+                cout << ", ";
+            }
+        };
+        if (withEpsilon) {
+            printOne("ε");
+        }
+        set.forEach([&](int column) { printOne(symbols.name(tableColumns[column])); });
+    }
+
+    // FIRST of a whole right hand side, returns true if it can derive ε
+    bool getProductionFirstSet(const vector<SymbolId>& production, TerminalSet& result) const {
+        result.clear();
+        for (SymbolId symbol : production) {
+            if (symbol == EPSILON) {
+                continue;
+            }
+            // If it's a terminal, add it and we're done
+            if (isTerminal(symbol)) {
+                result.insert(columnOf[symbol]);
+                return false;
+            }
+            result.unionWith(firstSets[rowOf[symbol]]);
+            // If this symbol doesn't derive epsilon, we stop here
+            if (!nullable[rowOf[symbol]]) {
+                return false;
+            }
+        }
+        // All symbols can derive epsilon (or the production is ε itself)
+        return true;
     }
 };
 
-#endif // CFG_H
\ No newline at end of file
+#endif // CFG_H
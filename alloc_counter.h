@@ -0,0 +1,77 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdlib>
+#include <new>
+#include "metrics.h"
+
+// Replaces the global operator new/delete with versions that count allocations into
+// allocationCount, which ScopedTimer reports per timed scope. Only counts while
+// Metrics::enabled(), so it costs one relaxed load otherwise. Include it in exactly
+// one .cpp of a program (replacement functions can only be defined once), and not at
+// all with CFG_NO_METRICS.
+//
+// Every form that reaches malloc has its matching delete here, and none of them are
+// inlined: a new the compiler can't see paired with a delete it sees as free() is
+// what -Wmismatched-new-delete warns about.
+
+#if defined(__GNUC__)
+#define ALLOC_COUNTER_NOINLINE __attribute__((noinline))
+#else
+#define ALLOC_COUNTER_NOINLINE
+#endif
+
+static inline void* countedAllocate(size_t size) noexcept {
+    if (Metrics::enabled()) {
+        allocationCount.fetch_add(1, memory_order_relaxed);
+    }
+    return malloc(size ? size : 1);
+}
+
+ALLOC_COUNTER_NOINLINE void* operator new(size_t size) {
+    if (void* memory = countedAllocate(size)) {
+        return memory;
+    }
+    throw bad_alloc();
+}
+
+ALLOC_COUNTER_NOINLINE void* operator new[](size_t size) {
+    if (void* memory = countedAllocate(size)) {
+        return memory;
+    }
+    throw bad_alloc();
+}
+
+ALLOC_COUNTER_NOINLINE void* operator new(size_t size, const nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+ALLOC_COUNTER_NOINLINE void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+ALLOC_COUNTER_NOINLINE void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+ALLOC_COUNTER_NOINLINE void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+ALLOC_COUNTER_NOINLINE void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+ALLOC_COUNTER_NOINLINE void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
+
+ALLOC_COUNTER_NOINLINE void operator delete(void* memory, const nothrow_t&) noexcept {
+    free(memory);
+}
+
+ALLOC_COUNTER_NOINLINE void operator delete[](void* memory, const nothrow_t&) noexcept {
+    free(memory);
+}
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,393 @@
+// Stage by stage benchmarks for the CFG pipeline and the parser.
+// Usage: cfg_bench [--large] [grammar.txt] [name filter]
+// --large adds the benchmarks that need close to a GB (the dense 1000 copies table).
+// Output follows Google Benchmark's layout: time per iteration, iterations and
+// throughput counters (grammar symbols/s for the analysis stages, tokens/s for
+// parsing) plus the peak resident memory each benchmark added on top of what the
+// process held when it started.
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include "../CFG.h"
+#include "../parser.h"
+#include "../lexer.h"
+#include "../token_scanner.h"
+#include "../mapped_file.h"
+#include "../sentence_generator.h"
+#include "generators.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Per benchmark loop state, same idea as benchmark::State: the body runs the timed
+// code once per iteration and may pause the clock around setup work
+class State {
+private:
+    chrono::steady_clock::time_point started;
+    chrono::nanoseconds elapsed{0};
+    bool running = false;
+
+public:
+    long long iterations = 0;
+    long long itemsProcessed = 0;
+
+    void resume() {
+        started = chrono::steady_clock::now();
+        running = true;
+    }
+
+    void pause() {
+        if (running) {
+            elapsed += chrono::steady_clock::now() - started;
+            running = false;
+        }
+    }
+
+    double seconds() const { return elapsed.count() / 1e9; }
+};
+
+struct Benchmark {
+    string name;
+    function<void(State&)> body;   // one iteration
+};
+
+static volatile long long lookupSink;    // keeps the lookup loop from being optimized out
+
+// Process wide high-water mark, only what the non Linux fallback can report
+static long peakMemoryKb() {
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+// A "VmRSS:" / "VmHWM:" line of /proc/self/status in KB, -1 if there is none
+static long procStatusKb(const string& field) {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, field.size(), field) == 0) {
+            return atol(line.c_str() + field.size());
+        }
+    }
+    return -1;
+}
+
+// Resets the kernel's peak RSS to the current RSS (Linux 4.0+), false if unsupported.
+// Free heap memory goes back to the OS first, or a benchmark reusing what setup freed
+// wouldn't show up at all
+static bool resetPeakRss() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.close();
+    return clearRefs.good() && procStatusKb("VmHWM:") >= 0;
+}
+
+static string humanRate(double perSecond) {
+    const char* units[] = {"", "k", "M", "G"};
+    int unit = 0;
+    while (perSecond >= 1000 && unit < 3) {
+        perSecond /= 1000;
+        unit++;
+    }
+    ostringstream out;
+    out << fixed << setprecision(2) << perSecond << units[unit] << "/s";
+    return out.str();
+}
+
+// Runs the body until at least minTime seconds of timed work have accumulated
+static void runBenchmark(const Benchmark& bench, double minTime = 0.2) {
+    // ru_maxrss never goes down, so every row after the biggest setup would show the
+    // same number: reset the high-water mark and count from the RSS at the start instead
+    bool isolated = resetPeakRss();
+    long startKb = isolated ? procStatusKb("VmRSS:") : 0;
+
+    State state;
+    while (state.seconds() < minTime && state.iterations < 1000000) {
+        state.resume();
+        bench.body(state);
+        state.pause();
+        state.iterations++;
+    }
+
+    double nsPerIter = state.seconds() * 1e9 / state.iterations;
+    cout << left << setw(44) << bench.name << right << setw(14) << fixed << setprecision(0) << nsPerIter << " ns"
+         << setw(11) << state.iterations;
+    if (state.itemsProcessed > 0) {
+        cout << "  items_per_second=" << humanRate(state.itemsProcessed / state.seconds());
+    }
+    if (isolated) {
+        cout << "  peak_rss=+" << setprecision(1) << max(0L, procStatusKb("VmHWM:") - startKb) / 1024.0 << "MB" << endl;
+    } else {
+        cout << "  peak_rss=" << peakMemoryKb() / 1024 << "MB" << endl;
+    }
+}
+
+static string writeTemp(const string& text, const string& name) {
+    string path = "/tmp/cfg_bench_" + to_string(
+#ifndef _WIN32
+        getpid()
+#else
+        0
+#endif
+    ) + "_" + name;
+    ofstream file(path);
+    file << text;
+    return path;
+}
+
+// Grammar size in symbols (lhs + rhs), the unit for the analysis throughput counters
+static long long grammarSymbols(const string& text) {
+    long long count = 0;
+    for (const string& line : grammarLines(text)) {
+        istringstream read(line);
+        string symbol;
+        while (read >> symbol) {
+            if (symbol != "->" && symbol != "|") count++;
+        }
+    }
+    return count;
+}
+
+int main(int argc, char* argv[]) {
+    bool large = false;
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--large") {
+            large = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    string grammarFile = args.size() > 0 ? args[0] : "grammar.txt";
+    string filter = args.size() > 1 ? args[1] : "";
+
+    MappedFile baseFile;
+    if (!baseFile.open(grammarFile) || baseFile.size() == 0) {
+        cout << "\033[31mError: Unable to open grammar file " << grammarFile << "\033[0m" << endl;
+        return 1;
+    }
+    string base(baseFile.view());
+
+    vector<Benchmark> benchmarks;
+    vector<string> tempFiles;
+
+    // Grammar analysis stages at growing grammar sizes
+    vector<pair<string, GrammarShape>> shapes = {
+        {"copies:1", {1, 0, 0}},
+        {"copies:10/ids:8/eps:8", {10, 8, 8}},
+        {"copies:100/ids:8/eps:32", {100, 8, 32}},
+        {"copies:1000/ids:4/eps:8", {1000, 4, 8}},
+    };
+
+    for (const auto& shape : shapes) {
+        string text = scaleGrammar(base, shape.second);
+        string path = writeTemp(text, "grammar_" + to_string(tempFiles.size()) + ".txt");
+        tempFiles.push_back(path);
+        long long symbols = grammarSymbols(text);
+
+        // Snapshots of the grammar right before each stage, copied for every iteration
+        auto prepared = make_shared<vector<CFG>>();
+        CFG cfg(path);
+        prepared->push_back(cfg);   // before LeftRecursion
+        cfg.LeftRecursion();
+        prepared->push_back(cfg);   // before LeftFactoring
+        cfg.LeftFactoring();
+        prepared->push_back(cfg);   // before computeFirstSets
+        cfg.computeFirstSets();
+        prepared->push_back(cfg);   // before computeFollowSets
+        cfg.computeFollowSets();
+        prepared->push_back(cfg);   // before constructParsingTable
+
+        string suffix = "/" + shape.first;
+        benchmarks.push_back({"BM_ReadFromFile" + suffix, [path, symbols](State& state) {
+            CFG loaded(path);
+            state.itemsProcessed += symbols;
+        }});
+
+        const char* stageNames[] = {"BM_LeftRecursion", "BM_LeftFactoring", "BM_ComputeFirstSets",
+                                    "BM_ComputeFollowSets", "BM_ConstructParsingTable"};
+        for (int stage = 0; stage < 5; stage++) {
+            if (stage == 4 && shape.second.copies > 100 && !large) {
+                continue;   // the dense table alone is ~770 MB at 1000 copies
+            }
+            benchmarks.push_back({stageNames[stage] + suffix, [prepared, stage, symbols](State& state) {
+                state.pause();
+                CFG copy = (*prepared)[stage];
+                state.resume();
+                switch (stage) {
+                    case 0: copy.LeftRecursion(); break;
+                    case 1: copy.LeftFactoring(); break;
+                    case 2: copy.computeFirstSets(); break;
+                    case 3: copy.computeFollowSets(); break;
+                    case 4: copy.constructParsingTable(); break;
+                }
+                state.itemsProcessed += symbols;
+            }});
+        }
+
+        // Table lookups in both layouts, over the (non-terminal, terminal) pairs in a
+        // random order so the big tables don't fit the cache (the 1000 copies table
+        // would take over a GB dense)
+        if (shape.second.copies > 100) {
+            continue;
+        }
+        cfg.constructParsingTable();
+        auto dense = make_shared<CFG>(cfg);
+        auto compressed = make_shared<CFG>(cfg);
+        compressed->setTableLayout(TableLayout::Compressed);
+        auto probes = make_shared<vector<pair<SymbolId, SymbolId>>>();
+        mt19937 random(42);
+        const vector<SymbolId>& rows = cfg.getTableRows();
+        const vector<SymbolId>& columns = cfg.getTableColumns();
+        for (int i = 0; i < 1 << 16; i++) {
+            probes->push_back({rows[random() % rows.size()], columns[random() % columns.size()]});
+        }
+        for (auto table : {dense, compressed}) {
+            string layout = table == dense ? "dense" : "compressed";
+            benchmarks.push_back({"BM_TableLookup/" + layout + suffix, [table, probes](State& state) {
+                long long sum = 0;
+                for (const auto& probe : *probes) {
+                    sum += table->getParsingTableEntry(probe.first, probe.second);
+                }
+                lookupSink = sum;
+                state.itemsProcessed += probes->size();
+            }});
+        }
+    }
+
+    // Parsing at growing input sizes, against the unscaled grammar
+    auto grammar = make_shared<CFG>(grammarFile);
+    grammar->LeftRecursion();
+    grammar->LeftFactoring();
+    grammar->computeFirstSets();
+    grammar->computeFollowSets();
+    grammar->constructParsingTable();
+    auto lexer = make_shared<Lexer>(*grammar);
+    auto compressedGrammar = make_shared<CFG>(*grammar);
+    compressedGrammar->setTableLayout(TableLayout::Compressed);
+
+    vector<pair<int, int>> inputs = {{1000, 10}, {1000, 100}, {100, 10000}};
+    for (const auto& input : inputs) {
+        auto lines = make_shared<vector<string>>(generateLines(input.first, input.second));
+        long long tokens = 0;
+        for (const string& line : *lines) {
+            istringstream read(line);
+            string token;
+            while (read >> token) tokens++;
+        }
+
+        string suffix = "/lines:" + to_string(input.first) + "/tokens:" + to_string(input.second);
+
+        // Whitespace splitting of the whole input as one buffer, per kernel
+        auto buffer = make_shared<string>();
+        for (const string& line : *lines) {
+            *buffer += line;
+            *buffer += '\n';
+        }
+        for (ScanKernel kernel : {ScanKernel::Scalar, ScanKernel::SSE2, ScanKernel::AVX2}) {
+            if (!TokenScanner::isSupported(kernel)) {
+                continue;
+            }
+            string name = string("BM_ScanTokens/") + TokenScanner::kernelName(kernel) + suffix;
+            benchmarks.push_back({name, [kernel, buffer](State& state) {
+                static vector<Token> tokens;
+                static vector<uint32_t> lineEnds;
+                tokens.clear();
+                lineEnds.clear();
+                TokenScanner::scan(kernel, *buffer, tokens, &lineEnds);
+                state.itemsProcessed += buffer->size();
+            }});
+        }
+        benchmarks.push_back({"BM_ParseString" + suffix, [grammar, lines, tokens](State& state) {
+            Parser parser(grammar.get());
+            for (const string& line : *lines) {
+                parser.parseLine(line);
+            }
+            state.itemsProcessed += tokens;
+        }});
+        benchmarks.push_back({"BM_ParseStringCompressed" + suffix, [compressedGrammar, lines, tokens](State& state) {
+            Parser parser(compressedGrammar.get());
+            for (const string& line : *lines) {
+                parser.parseLine(line);
+            }
+            state.itemsProcessed += tokens;
+        }});
+        benchmarks.push_back({"BM_ParseStringLexer" + suffix, [grammar, lexer, lines, tokens](State& state) {
+            Parser parser(grammar.get());
+            parser.setLexer(lexer.get());
+            for (const string& line : *lines) {
+                parser.parseLine(line);
+            }
+            state.itemsProcessed += tokens;
+        }});
+    }
+
+    // Parsing corpora from SentenceGenerator: ordinary statements, deep IF nesting (parser
+    // stack worst case) and the statements with one random edit each (error recovery)
+    struct Corpus {
+        string name;
+        GeneratorOptions options;
+        int lines;
+        bool mutated;
+    };
+    vector<Corpus> corpora = {
+        {"statements", {100, 64, 0}, 1000, false},
+        {"nested", {0, 2000, 1000}, 100, false},
+        {"mutated", {100, 64, 0}, 1000, true},
+    };
+    for (const Corpus& corpus : corpora) {
+        SentenceGenerator generator(*grammar, corpus.options);
+        auto lines = make_shared<vector<string>>();
+        long long tokens = 0;
+        vector<SymbolId> sentence;
+        for (int l = 0; l < corpus.lines; l++) {
+            sentence.clear();
+            generator.generate(sentence);
+            if (corpus.mutated) generator.mutate(sentence);
+            tokens += sentence.size();
+            lines->push_back(generator.toText(sentence));
+        }
+        benchmarks.push_back({"BM_ParseGenerated/" + corpus.name, [grammar, lines, tokens](State& state) {
+            static ParseContext context;
+            Parser parser(grammar.get());
+            for (const string& line : *lines) {
+                parser.parseLine(line, context);
+            }
+            state.itemsProcessed += tokens;
+        }});
+    }
+
+    cout << left << setw(44) << "Benchmark" << right << setw(17) << "Time" << setw(11) << "Iterations" << endl;
+    cout << string(100, '-') << endl;
+    for (const auto& bench : benchmarks) {
+        if (filter.empty() || bench.name.find(filter) != string::npos) {
+            runBenchmark(bench);
+        }
+    }
+
+    for (const string& path : tempFiles) {
+        remove(path.c_str());
+    }
+    return 0;
+}
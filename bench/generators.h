@@ -0,0 +1,134 @@
+#ifndef BENCH_GENERATORS_H
+#define BENCH_GENERATORS_H
+
+#include <cctype>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Synthetic workloads for the benchmarks, all derived from the shape of grammar.txt
+
+struct GrammarShape {
+    int copies = 1;         // independent copies of the statement language (more non-terminals)
+    int extraIds = 0;       // extra alternatives on every ID rule (wider rows, more terminals)
+    int epsilonChain = 0;   // length of a nullable PAD chain inside DECL (deep FIRST/FOLLOW propagation)
+};
+
+// Splits "A -> x y | z" grammar text into lines, skipping blank ones
+inline vector<string> grammarLines(const string& text) {
+    vector<string> lines;
+    istringstream in(text);
+    string line;
+    while (getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") != string::npos) {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+// Scales a base grammar (normally grammar.txt). Copy k > 0 renames every non-terminal
+// and every word-like terminal with a "_k" suffix, so the copies are LL(1) on their
+// own; the first copy's second rule (STMT) gets an alternative for each copy's STMT.
+inline string scaleGrammar(const string& base, const GrammarShape& shape) {
+    vector<string> lines = grammarLines(base);
+    vector<string> lhs;
+    for (const string& line : lines) {
+        istringstream read(line);
+        string name;
+        read >> name;
+        lhs.push_back(name);
+    }
+    auto isNonTerminal = [&](const string& symbol) {
+        for (const string& name : lhs) {
+            if (name == symbol) return true;
+        }
+        return false;
+    };
+
+    vector<string> out;
+    for (int k = 0; k < shape.copies; k++) {
+        string suffix = k == 0 ? "" : "_" + to_string(k);
+        for (size_t i = 0; i < lines.size(); i++) {
+            istringstream read(lines[i]);
+            string symbol, rule;
+            while (read >> symbol) {
+                bool word = isalpha((unsigned char)symbol[0]);
+                if (symbol != "->" && symbol != "|" && symbol != "ε" && (isNonTerminal(symbol) || word)) {
+                    symbol += suffix;
+                }
+                if (lhs[i] == "ID" && symbol == "->") {
+                    rule += "-> ";
+                    for (int e = 0; e < shape.extraIds; e++) {
+                        rule += "v" + to_string(e) + suffix + " | ";
+                    }
+                    continue;
+                }
+                if (lhs[i] == "DECL" && shape.epsilonChain > 0 && symbol == "ID" + suffix) {
+                    rule += "PAD0" + suffix + " ";
+                }
+                rule += symbol + " ";
+            }
+            out.push_back(rule);
+        }
+        for (int e = 0; e < shape.epsilonChain; e++) {
+            string next = e + 1 < shape.epsilonChain ? "PAD" + to_string(e + 1) + suffix : "pad" + suffix;
+            out.push_back("PAD" + to_string(e) + suffix + " -> " + next + " | ε ");
+        }
+    }
+
+    // Hook the copies into the first copy's statement rule
+    if (lines.size() > 1) {
+        for (int k = 1; k < shape.copies; k++) {
+            out[1] += "| " + lhs[1] + "_" + to_string(k) + " ";
+        }
+    }
+
+    string text;
+    for (const string& line : out) {
+        text += line + "\n";
+    }
+    return text;
+}
+
+// Random valid statements of the grammar.txt language (first copy), whitespace
+// separated, until every line has at least tokensPerLine tokens
+inline vector<string> generateLines(int lineCount, int tokensPerLine, unsigned seed = 42) {
+    mt19937 rng(seed);
+    const char* ids[] = {"x", "y", "z"};
+    const char* ops[] = {"+", "-"};
+    const char* rels[] = {">", "<", "=="};
+    auto pick = [&](int n) { return (int)(rng() % n); };
+    auto term = [&]() { return pick(2) ? string(ids[pick(3)]) : to_string(pick(10)); };
+
+    vector<string> lines;
+    for (int l = 0; l < lineCount; l++) {
+        string line;
+        int tokens = 0;
+        while (tokens < tokensPerLine) {
+            int kind = pick(3);
+            if (kind == 0) {
+                line += "int " + string(ids[pick(3)]) + " ; ";
+                tokens += 3;
+            } else if (kind == 1) {
+                line += string(ids[pick(3)]) + " = " + term() + " ";
+                tokens += 3;
+                for (int t = pick(4); t > 0; t--) {
+                    line += string(ops[pick(2)]) + " " + term() + " ";
+                    tokens += 2;
+                }
+                line += "; ";
+                tokens++;
+            } else {
+                line += "if ( " + term() + " " + rels[pick(3)] + " " + term() + " ) { " + ids[pick(3)] + " = " + term() + " ; } ";
+                tokens += 12;
+            }
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+#endif // BENCH_GENERATORS_H
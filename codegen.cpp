@@ -0,0 +1,249 @@
+#include "codegen.h"
+#include <set>
+
+CodeGenerator::CodeGenerator(const CFG& grammar) : cfg(grammar) {
+    assignNames();
+}
+
+// "int" -> T_int, "(" -> T_LPAREN, "==" -> T_EQ_EQ, "E'" -> N_E_
+string CodeGenerator::identifierFor(const string& symbol, const string& prefix) {
+    static const map<char, string> punctuation = {
+        {'(', "LPAREN"}, {')', "RPAREN"}, {'{', "LBRACE"}, {'}', "RBRACE"}, {'[', "LBRACK"},
+        {']', "RBRACK"}, {';', "SEMI"}, {',', "COMMA"}, {'.', "DOT"}, {':', "COLON"},
+        {'=', "EQ"}, {'<', "LT"}, {'>', "GT"}, {'!', "BANG"}, {'+', "PLUS"}, {'-', "MINUS"},
+        {'*', "STAR"}, {'/', "SLASH"}, {'%', "PERCENT"}, {'&', "AMP"}, {'|', "BAR"},
+        {'^', "CARET"}, {'~', "TILDE"}, {'?', "QUESTION"}, {'$', "END"}, {'\'', "_"},
+    };
+
+    string name = prefix;
+    bool lastWasWord = false;
+    for (char c : symbol) {
+        if (isalnum((unsigned char)c) || c == '_') {
+            name += c;
+            lastWasWord = false;
+            continue;
+        }
+        auto it = punctuation.find(c);
+        string word = it != punctuation.end() ? it->second : "X" + to_string((unsigned char)c);
+        if (lastWasWord && word != "_") {
+            name += "_";
+        }
+        name += word;
+        lastWasWord = word != "_";
+    }
+    return name;
+}
+
+string CodeGenerator::quoted(const string& text) {
+    string result = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result + "\"";
+}
+
+void CodeGenerator::assignNames() {
+    const SymbolTable& symbols = cfg.getSymbols();
+    set<string> used;
+    auto unique = [&](string name) {
+        string candidate = name;
+        for (int n = 2; used.count(candidate); n++) {
+            candidate = name + "_" + to_string(n);
+        }
+        used.insert(candidate);
+        return candidate;
+    };
+
+    for (SymbolId terminal : cfg.getTableColumns()) {
+        terminalNames.push_back(unique(identifierFor(symbols.name(terminal), "T_")));
+    }
+    for (SymbolId nonTerminal : cfg.getTableRows()) {
+        nonTerminalNames.push_back(unique(identifierFor(symbols.name(nonTerminal), "N_")));
+    }
+}
+
+// Symbols on the generated stack: terminals by column, non-terminals after them by row
+string CodeGenerator::stackSymbol(SymbolId symbol) const {
+    const vector<SymbolId>& columns = cfg.getTableColumns();
+    const vector<SymbolId>& rows = cfg.getTableRows();
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i] == symbol) return terminalNames[i];
+    }
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (rows[i] == symbol) return nonTerminalNames[i];
+    }
+    return "T_END";
+}
+
+string CodeGenerator::generate(const string& namespaceName, const string& sourceName) const {
+    const SymbolTable& symbols = cfg.getSymbols();
+    const vector<SymbolId>& columns = cfg.getTableColumns();
+    const vector<SymbolId>& rows = cfg.getTableRows();
+    int productionCount = cfg.getProductionCount();
+
+    string guard = identifierFor(namespaceName, "");
+    transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+    guard += "_GENERATED_H";
+
+    ostringstream out;
+    out << "// Generated by cfg_codegen from " << sourceName << ", do not edit.\n";
+    out << "#ifndef " << guard << "\n#define " << guard << "\n\n";
+    out << "#include <string_view>\n#include <vector>\n\n";
+    out << "namespace " << namespaceName << " {\n\n";
+
+    // Symbols
+    out << "// Terminals are table columns, non-terminals follow them so both fit on one stack\n";
+    out << "enum Symbol : int {\n";
+    for (size_t i = 0; i < columns.size(); i++) {
+        out << "    " << terminalNames[i] << " = " << i << ",    // " << symbols.name(columns[i]) << "\n";
+    }
+    for (size_t i = 0; i < rows.size(); i++) {
+        out << "    " << nonTerminalNames[i] << " = " << columns.size() + i << ",    // " << symbols.name(rows[i]) << "\n";
+    }
+    out << "};\n\n";
+    out << "constexpr int TERMINAL_COUNT = " << columns.size() << ";\n";
+    out << "constexpr int NONTERMINAL_COUNT = " << rows.size() << ";\n";
+    out << "constexpr int PRODUCTION_COUNT = " << productionCount << ";\n";
+    out << "constexpr int START_SYMBOL = " << stackSymbol(cfg.getStartSymbolId()) << ";\n";
+    out << "\n";
+
+    out << "constexpr const char* SYMBOL_NAMES[TERMINAL_COUNT + NONTERMINAL_COUNT] = {\n   ";
+    for (SymbolId terminal : columns) out << " " << quoted(symbols.name(terminal)) << ",";
+    out << "\n   ";
+    for (SymbolId nonTerminal : rows) out << " " << quoted(symbols.name(nonTerminal)) << ",";
+    out << "\n};\n\n";
+
+    // Terminal lookup: switch on the length, then compare against that length's spellings
+    out << "// Terminal for a token's text, -1 if it isn't one\n";
+    out << "inline int lookupTerminal(std::string_view text) {\n";
+    out << "    switch (text.size()) {\n";
+    map<size_t, vector<size_t>> byLength;
+    for (size_t i = 1; i < columns.size(); i++) {   // column 0 is $, never spelled in the input
+        byLength[symbols.name(columns[i]).size()].push_back(i);
+    }
+    for (const auto& group : byLength) {
+        out << "        case " << group.first << ":\n";
+        for (size_t column : group.second) {
+            out << "            if (text == " << quoted(symbols.name(columns[column])) << ") return " << terminalNames[column] << ";\n";
+        }
+        out << "            return -1;\n";
+    }
+    out << "    }\n    return -1;\n}\n\n";
+
+    // Parser
+    out << "struct Result {\n    bool accepted;\n    int errors;\n};\n\n";
+    out << "// LL(1) parse of terminals (no end marker) with panic mode recovery. stack is only\n";
+    out << "// scratch space, pass the same vector again to avoid allocating\n";
+    out << "inline Result parse(const int* tokens, int count, std::vector<int>& stack) {\n";
+    out << "    stack.clear();\n";
+    out << "    stack.push_back(T_END);\n";
+    out << "    stack.push_back(START_SYMBOL);\n";
+    out << "    int pos = 0;\n    int errors = 0;\n    bool recovering = false;\n";
+    out << "    auto error = [&]() {\n        if (!recovering) {\n            errors++;\n            recovering = true;\n        }\n    };\n\n";
+    out << "    while (!stack.empty()) {\n";
+    out << "        int token = pos < count ? tokens[pos] : T_END;\n";
+    out << "        int top = stack.back();\n\n";
+    out << "        if (top < TERMINAL_COUNT) {\n";
+    out << "            if (top == token) {\n";
+    out << "                if (token == T_END) return {errors == 0, errors};\n";
+    out << "                stack.pop_back();\n                pos++;\n                recovering = false;\n";
+    out << "            } else if (top == T_END) {\n";
+    out << "                error();    // input left after the sentence\n";
+    out << "                return {false, errors};\n";
+    out << "            } else {\n";
+    out << "                error();    // missing terminal, act as if it was there\n";
+    out << "                stack.pop_back();\n";
+    out << "            }\n";
+    out << "            continue;\n";
+    out << "        }\n\n";
+    out << "        switch (top) {\n";
+    for (size_t row = 0; row < rows.size(); row++) {
+        out << "        case " << nonTerminalNames[row] << ":\n";
+        out << "            switch (token) {\n";
+
+        // Group the columns by what happens in them
+        map<int, vector<size_t>> cells;
+        for (size_t column = 0; column < columns.size(); column++) {
+            int cell = cfg.getTableCell(row, column);
+            if (cell != TABLE_ERROR) {
+                cells[cell].push_back(column);
+            }
+        }
+        for (const auto& cell : cells) {
+            for (size_t column : cell.second) {
+                out << "            case " << terminalNames[column] << ":\n";
+            }
+            if (cell.first == TABLE_SYNCH) {
+                out << "                error();    // synch\n";
+                out << "                stack.pop_back();\n";
+                out << "                continue;\n";
+                continue;
+            }
+            SymbolSpan rhs = cfg.getProductionRhs(cell.first);
+            string production = cfg.productionToString(cell.first);
+            out << "                // " << production.substr(0, production.find_last_not_of(' ') + 1) << "\n";
+            if (rhs.empty()) {
+                out << "                stack.pop_back();\n";
+            } else {
+                out << "                stack.back() = " << stackSymbol(rhs[rhs.size() - 1]) << ";\n";
+                for (int i = rhs.size() - 2; i >= 0; i--) {
+                    out << "                stack.push_back(" << stackSymbol(rhs[i]) << ");\n";
+                }
+            }
+            out << "                recovering = false;\n";
+            out << "                continue;\n";
+        }
+        out << "            default:\n";
+        out << "                error();\n";
+        out << "                if (token == T_END) stack.pop_back();\n";
+        out << "                else pos++;\n";
+        out << "                continue;\n";
+        out << "            }\n";
+    }
+    out << "        }\n";
+    out << "    }\n";
+    out << "    return {false, errors};\n";
+    out << "}\n\n";
+
+    out << "// Whitespace tokenization + parse of one line, tokens and stack are scratch space\n";
+    out << "inline Result validate(std::string_view line, std::vector<int>& tokens, std::vector<int>& stack) {\n";
+    out << "    tokens.clear();\n";
+    out << "    size_t pos = 0;\n";
+    out << "    while (pos < line.size()) {\n";
+    out << "        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\\t' || line[pos] == '\\r' || line[pos] == '\\n')) pos++;\n";
+    out << "        size_t start = pos;\n";
+    out << "        while (pos < line.size() && !(line[pos] == ' ' || line[pos] == '\\t' || line[pos] == '\\r' || line[pos] == '\\n')) pos++;\n";
+    out << "        if (pos > start) tokens.push_back(lookupTerminal(line.substr(start, pos - start)));\n";
+    out << "    }\n";
+    out << "    return parse(tokens.data(), tokens.size(), stack);\n";
+    out << "}\n\n";
+
+    out << "} // namespace " << namespaceName << "\n\n";
+    out << "#endif // " << guard << "\n";
+    return out.str();
+}
+
+bool CodeGenerator::writeFile(const string& path, const string& namespaceName, const string& sourceName) const {
+    string source = generate(namespaceName, sourceName);
+
+    // Leave the file alone when nothing changed so the build doesn't recompile its users
+    ifstream existing(path, ios::binary);
+    if (existing.is_open()) {
+        stringstream current;
+        current << existing.rdbuf();
+        if (current.str() == source) {
+            return true;
+        }
+        existing.close();
+    }
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << source;
+    return bool(file);
+}
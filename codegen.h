@@ -0,0 +1,37 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include <string>
+#include <vector>
+#include "CFG.h"
+
+using namespace std;
+
+// Writes a stand-alone C++ header with an LL(1) parser specialized to one analysed CFG
+// (call it after constructParsingTable). Terminals and non-terminals become enum
+// constants and the parse loop is a switch per non-terminal, with the table cells as
+// case labels and the expansions written out as constant pushes, so the compiler can
+// inline and branch-optimize it. No table or production arrays are emitted, so the
+// production count has no cell type to overflow. The generated parser uses the same
+// panic mode recovery as Parser.
+class CodeGenerator {
+private:
+    const CFG& cfg;
+    vector<string> terminalNames;       // C++ identifiers, by table column
+    vector<string> nonTerminalNames;    // C++ identifiers, by table row
+
+    static string identifierFor(const string& symbol, const string& prefix);
+    static string quoted(const string& text);
+    void assignNames();
+    string stackSymbol(SymbolId symbol) const;
+
+public:
+    CodeGenerator(const CFG& grammar);
+
+    // Returns the generated source. namespaceName wraps everything it defines
+    string generate(const string& namespaceName, const string& sourceName) const;
+
+    bool writeFile(const string& path, const string& namespaceName, const string& sourceName) const;
+};
+
+#endif // CODEGEN_H
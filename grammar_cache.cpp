@@ -0,0 +1,341 @@
+#include "grammar_cache.h"
+#include <cerrno>
+#include <cstring>
+#include "mapped_file.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MAGIC[4] = {'L', 'L', '1', 'C'};
+
+// Appends plain values to a byte buffer (native byte order, the cache is per machine)
+class BlobWriter {
+public:
+    string bytes;
+
+    template <typename T>
+    void put(T value) {
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void putArray(const T* values, size_t count) {
+        put<uint32_t>(count);
+        bytes.append(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+};
+
+// Bounds checked reads out of the mapped file
+class BlobReader {
+private:
+    const char* cursor;
+    const char* end;
+
+public:
+    bool ok = true;
+
+    BlobReader(string_view data) : cursor(data.data()), end(data.data() + data.size()) {}
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (end - cursor < (ptrdiff_t)sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+
+    // Whether count records of at least recordSize bytes each can still follow. Checked
+    // before anything is sized by a count from the file, so a corrupt count fails here
+    // instead of asking for gigabytes
+    bool fits(size_t count, size_t recordSize) {
+        if (!ok || (size_t)(end - cursor) / recordSize < count) {
+            ok = false;
+        }
+        return ok;
+    }
+
+    template <typename T>
+    void getArray(vector<T>& out) {
+        uint32_t count = get<uint32_t>();
+        if (!fits(count, sizeof(T))) {
+            return;
+        }
+        out.resize(count);
+        memcpy(out.data(), cursor, count * sizeof(T));
+        cursor += count * sizeof(T);
+    }
+
+    string_view getString() {
+        uint32_t length = get<uint32_t>();
+        if (!ok || (size_t)(end - cursor) < length) {
+            ok = false;
+            return {};
+        }
+        string_view result(cursor, length);
+        cursor += length;
+        return result;
+    }
+};
+
+uint64_t GrammarCache::hashSource(string_view text) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t GrammarCache::hashFile(const string& filename) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        return 0;
+    }
+    return hashSource(file.view());
+}
+
+bool GrammarCache::save(const CFG& cfg, const string& path, uint64_t sourceHash) {
+    if (cfg.productions.empty() || cfg.productionList.empty()) {
+        return false;   // only fully analysed grammars are worth caching
+    }
+
+    BlobWriter out;
+    out.bytes.append(MAGIC, 4);
+    out.put<uint32_t>(VERSION);
+    out.put<uint64_t>(sourceHash);
+
+    // Symbol table (ids are implied by the order)
+    out.put<uint32_t>(cfg.symbols.size());
+    for (SymbolId id = 0; id < cfg.symbols.size(); id++) {
+        out.put<uint8_t>(cfg.symbols.isNonTerminal(id));
+        const string& name = cfg.symbols.name(id);
+        out.putArray(name.data(), name.size());
+    }
+
+    // Transformed grammar
+    out.put<int32_t>(cfg.start_symbol);
+    out.putArray(cfg.nonTerminalOrder.data(), cfg.nonTerminalOrder.size());
+    for (SymbolId nonTerminal : cfg.nonTerminalOrder) {
+        const auto& rules = cfg.productions.at(nonTerminal);
+        out.put<uint32_t>(rules.size());
+        for (const auto& rule : rules) {
+            out.putArray(rule.data(), rule.size());
+        }
+    }
+
+    // FIRST / FOLLOW / nullable, one row per non-terminal
+    for (size_t row = 0; row < cfg.tableRows.size(); row++) {
+        out.put<uint8_t>(cfg.nullable[row]);
+        out.putArray(cfg.firstSets[row].data(), cfg.firstSets[row].wordCount());
+        out.putArray(cfg.followSets[row].data(), cfg.followSets[row].wordCount());
+    }
+
+    // Flat parse table
+    out.putArray(cfg.rhsPool.data(), cfg.rhsPool.size());
+    out.putArray(cfg.productionList.data(), cfg.productionList.size());
+    out.put<uint8_t>(cfg.tableLayout == TableLayout::Compressed);
+    if (cfg.tableLayout == TableLayout::Compressed) {
+        out.putArray(cfg.compressedTable.rows.data(), cfg.compressedTable.rows.size());
+        out.putArray(cfg.compressedTable.columnIndex.data(), cfg.compressedTable.columnIndex.size());
+        out.putArray(cfg.compressedTable.slots.data(), cfg.compressedTable.slots.size());
+    } else {
+        out.putArray(cfg.parsing_table.data(), cfg.parsing_table.size());
+    }
+    out.putArray(cfg.conflicts.data(), cfg.conflicts.size());
+
+    // Write to a temp file first so a crash never leaves a half written cache behind.
+    // Its name is unique per save, so concurrent saves of the same cache can't write into
+    // each other's file; whichever renames last wins, and both versions are complete
+#ifndef _WIN32
+    string tempPath = path + ".XXXXXX";
+    int fd = mkstemp(tempPath.data());
+    if (fd < 0) {
+        return false;
+    }
+    fchmod(fd, 0644);   // mkstemp creates it 0600
+    const char* data = out.bytes.data();
+    size_t remaining = out.bytes.size();
+    while (remaining > 0) {
+        ssize_t written = write(fd, data, remaining);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            break;
+        }
+        data += written;
+        remaining -= written;
+    }
+    if (close(fd) != 0 || remaining > 0) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+#else
+    string tempPath = path + ".tmp";
+    ofstream file(tempPath, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(out.bytes.data(), out.bytes.size());
+    file.close();
+    if (!file) {
+        remove(tempPath.c_str());
+        return false;
+    }
+#endif
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool GrammarCache::load(CFG& cfg, const string& path, uint64_t sourceHash) {
+    MappedFile file;
+    if (!file.open(path) || file.size() < 4 || memcmp(file.data(), MAGIC, 4) != 0) {
+        return false;
+    }
+
+    BlobReader in(file.view().substr(4));
+    if (in.get<uint32_t>() != VERSION || in.get<uint64_t>() != sourceHash || !in.ok) {
+        return false;
+    }
+
+    CFG loaded;
+    uint32_t symbolCount = in.get<uint32_t>();
+    if (!in.fits(symbolCount, sizeof(uint8_t) + sizeof(uint32_t))) {
+        return false;
+    }
+    for (uint32_t id = 0; id < symbolCount && in.ok; id++) {
+        bool nonTerminal = in.get<uint8_t>();
+        SymbolId interned = loaded.symbols.intern(in.getString());
+        if (interned != (SymbolId)id) {
+            return false;
+        }
+        if (nonTerminal) {
+            loaded.symbols.setNonTerminal(interned);
+        }
+    }
+
+    loaded.start_symbol = in.get<int32_t>();
+    in.getArray(loaded.nonTerminalOrder);
+    for (SymbolId nonTerminal : loaded.nonTerminalOrder) {
+        if (!in.ok || !loaded.symbols.isNonTerminal(nonTerminal)) {
+            return false;
+        }
+        uint32_t ruleCount = in.get<uint32_t>();
+        if (!in.fits(ruleCount, sizeof(uint32_t))) {     // every rule has at least its length
+            return false;
+        }
+        auto& rules = loaded.productions[nonTerminal];
+        rules.resize(ruleCount);
+        for (auto& rule : rules) {
+            in.getArray(rule);
+            for (SymbolId symbol : rule) {
+                if (symbol < 0 || symbol >= (SymbolId)symbolCount) {
+                    return false;
+                }
+            }
+        }
+    }
+    if (!in.ok || !loaded.symbols.isNonTerminal(loaded.start_symbol)) {
+        return false;
+    }
+
+    loaded.indexSymbols();
+    size_t rows = loaded.tableRows.size();
+    size_t words = (loaded.tableColumns.size() + 63) / 64;
+    if (!in.fits(rows, sizeof(uint8_t) + 2 * (sizeof(uint32_t) + words * sizeof(uint64_t)))) {
+        return false;
+    }
+    loaded.nullable.assign(rows, false);
+    loaded.firstSets.assign(rows, TerminalSet(loaded.tableColumns.size()));
+    loaded.followSets.assign(rows, TerminalSet(loaded.tableColumns.size()));
+    vector<uint64_t> buffer;
+    for (size_t row = 0; row < rows && in.ok; row++) {
+        loaded.nullable[row] = in.get<uint8_t>();
+        in.getArray(buffer);
+        if (buffer.size() != words) return false;
+        memcpy(loaded.firstSets[row].data(), buffer.data(), words * sizeof(uint64_t));
+        in.getArray(buffer);
+        if (buffer.size() != words) return false;
+        memcpy(loaded.followSets[row].data(), buffer.data(), words * sizeof(uint64_t));
+    }
+
+    in.getArray(loaded.rhsPool);
+    in.getArray(loaded.productionList);
+    // The parser indexes the tables with these without checking: symbols on a right hand
+    // side are real terminals or non-terminals (never epsilon or $)
+    for (SymbolId symbol : loaded.rhsPool) {
+        if (symbol <= END_MARKER || symbol >= (SymbolId)symbolCount) {
+            return false;
+        }
+    }
+    for (const Production& prod : loaded.productionList) {
+        if (prod.offset < 0 || prod.length < 0 || !loaded.symbols.isNonTerminal(prod.lhs) ||
+            (size_t)prod.offset + (size_t)prod.length > loaded.rhsPool.size()) {
+            return false;
+        }
+    }
+    auto validEntry = [&](int entry) {
+        return entry >= TABLE_SYNCH && entry < (int)loaded.productionList.size();
+    };
+    bool compressed = in.get<uint8_t>();
+    if (compressed) {
+        CompressedTable& table = loaded.compressedTable;
+        size_t columns = loaded.tableColumns.size();
+        in.getArray(table.rows);
+        in.getArray(table.columnIndex);
+        in.getArray(table.slots);
+        if (!in.ok || table.rows.size() != rows || table.columnIndex.size() != columns) {
+            return false;
+        }
+        for (const CompressedTable::Row& row : table.rows) {
+            if (row.base < 0 || row.base + columns > table.slots.size() || !validEntry(row.defaultValue)) {
+                return false;
+            }
+        }
+        for (int position : table.columnIndex) {
+            if (position < 0 || position >= (int)columns) {
+                return false;
+            }
+        }
+        for (const CompressedTable::Slot& slot : table.slots) {
+            if (slot.check < -1 || slot.check >= (int)rows || !validEntry(slot.value)) {
+                return false;
+            }
+        }
+        loaded.tableLayout = TableLayout::Compressed;
+    } else {
+        in.getArray(loaded.parsing_table);
+        if (!in.ok || loaded.parsing_table.size() != rows * loaded.tableColumns.size()) {
+            return false;
+        }
+        for (int entry : loaded.parsing_table) {
+            if (!validEntry(entry)) {
+                return false;
+            }
+        }
+    }
+    in.getArray(loaded.conflicts);
+    if (!in.ok) {
+        return false;
+    }
+    for (const TableConflict& conflict : loaded.conflicts) {
+        int productionCount = loaded.productionList.size();
+        if (conflict.existing < 0 || conflict.existing >= productionCount ||
+            conflict.incoming < 0 || conflict.incoming >= productionCount ||
+            !loaded.symbols.isNonTerminal(conflict.nonTerminal) || !loaded.symbols.isTerminal(conflict.terminal)) {
+            return false;
+        }
+    }
+
+    cfg = move(loaded);
+    return true;
+}
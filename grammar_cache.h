@@ -0,0 +1,36 @@
+#ifndef GRAMMAR_CACHE_H
+#define GRAMMAR_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "CFG.h"
+
+using namespace std;
+
+// Binary snapshot of a fully analysed CFG (after LeftRecursion, LeftFactoring, FIRST,
+// FOLLOW and constructParsingTable): symbol table, transformed productions, the sets
+// and the flat parse table. The file is keyed by a hash of the grammar source, so a
+// stale cache is simply ignored and rebuilt.
+class GrammarCache {
+public:
+    static const uint32_t VERSION = 5;     // 2: synch entries in the table, 3: conflicts, 4: table layout,
+                                           // 5: left factoring skips names taken by terminals
+
+    // FNV-1a over the grammar text
+    static uint64_t hashSource(string_view text);
+
+    // Hash of a grammar file's contents, 0 if it can't be read
+    static uint64_t hashFile(const string& filename);
+
+    // Default cache location next to the grammar ("grammar.txt" -> "grammar.txt.ll1")
+    static string cachePath(const string& grammarFile) { return grammarFile + ".ll1"; }
+
+    static bool save(const CFG& cfg, const string& path, uint64_t sourceHash);
+
+    // Fills an empty CFG from the cache, false if the file is missing, corrupt,
+    // from another version or built from a different grammar source
+    static bool load(CFG& cfg, const string& path, uint64_t sourceHash);
+};
+
+#endif // GRAMMAR_CACHE_H
@@ -0,0 +1,88 @@
+#include "grammar_registry.h"
+#include "grammar_cache.h"
+#include <mutex>
+
+shared_ptr<GrammarRegistry::Slot> GrammarRegistry::findSlot(const string& name) const {
+    shared_lock<shared_mutex> guard(lock);
+    auto it = slots.find(name);
+    return it == slots.end() ? nullptr : it->second;
+}
+
+shared_ptr<const CompiledGrammar> GrammarRegistry::compile(const string& name, const string& grammarFile, bool useCache) {
+    ifstream probe(grammarFile);
+    if (!probe.is_open()) {
+        return nullptr;
+    }
+    probe.close();
+
+    uint64_t hash = GrammarCache::hashFile(grammarFile);
+    string cacheFile = GrammarCache::cachePath(grammarFile);
+    CFG cfg;
+    if (!useCache || !GrammarCache::load(cfg, cacheFile, hash)) {
+        cfg = CFG(grammarFile);
+        cfg.LeftRecursion();
+        cfg.LeftFactoring();
+        cfg.computeFirstSets();
+        cfg.computeFollowSets();
+        cfg.constructParsingTable();
+        if (useCache) {
+            GrammarCache::save(cfg, cacheFile, hash);
+        }
+    }
+    if (cfg.getProductionCount() == 0) {
+        return nullptr;
+    }
+
+    long long generation;
+    {
+        unique_lock<shared_mutex> guard(lock);
+        generation = nextGeneration++;
+    }
+    return make_shared<const CompiledGrammar>(name, grammarFile, hash, generation, move(cfg));
+}
+
+bool GrammarRegistry::load(const string& name, const string& grammarFile, bool useCache) {
+    shared_ptr<const CompiledGrammar> grammar = compile(name, grammarFile, useCache);
+    if (!grammar) {
+        return false;
+    }
+    publish(name, move(grammar));
+    return true;
+}
+
+bool GrammarRegistry::reload(const string& name, bool useCache) {
+    shared_ptr<const CompiledGrammar> current = get(name);
+    return current && load(name, current->sourceFile, useCache);
+}
+
+void GrammarRegistry::publish(const string& name, shared_ptr<const CompiledGrammar> grammar) {
+    shared_ptr<Slot> slot = findSlot(name);
+    if (!slot) {
+        unique_lock<shared_mutex> guard(lock);
+        shared_ptr<Slot>& entry = slots[name];
+        if (!entry) {
+            entry = make_shared<Slot>();
+        }
+        slot = entry;
+    }
+    atomic_store(&slot->grammar, move(grammar));
+}
+
+shared_ptr<const CompiledGrammar> GrammarRegistry::get(const string& name) const {
+    shared_ptr<Slot> slot = findSlot(name);
+    return slot ? atomic_load(&slot->grammar) : nullptr;
+}
+
+bool GrammarRegistry::remove(const string& name) {
+    unique_lock<shared_mutex> guard(lock);
+    return slots.erase(name) > 0;
+}
+
+vector<string> GrammarRegistry::names() const {
+    shared_lock<shared_mutex> guard(lock);
+    vector<string> result;
+    for (const auto& entry : slots) {
+        result.push_back(entry.first);
+    }
+    return result;
+}
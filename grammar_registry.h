@@ -0,0 +1,84 @@
+#ifndef GRAMMAR_REGISTRY_H
+#define GRAMMAR_REGISTRY_H
+
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "CFG.h"
+#include "lexer.h"
+#include "parser.h"
+
+using namespace std;
+
+// A fully analysed grammar and its lexer, frozen: nothing changes after construction,
+// so any number of threads can parse with it. Handed out as shared_ptr<const ...>;
+// replacing a grammar never touches an instance a parser still holds.
+class CompiledGrammar : public enable_shared_from_this<CompiledGrammar> {
+public:
+    const string name;
+    const string sourceFile;
+    const uint64_t sourceHash;
+    const long long generation;     // registry wide counter, higher = published later
+    const CFG cfg;
+    const Lexer lexer;
+
+    CompiledGrammar(string grammarName, string file, uint64_t hash, long long version, CFG&& analysed)
+        : name(move(grammarName)), sourceFile(move(file)), sourceHash(hash), generation(version),
+          cfg(move(analysed)), lexer(cfg) {}
+
+    CompiledGrammar(const CompiledGrammar&) = delete;
+    CompiledGrammar& operator=(const CompiledGrammar&) = delete;
+
+    // The CFG, sharing ownership of the whole compiled grammar
+    shared_ptr<const CFG> shareCfg() const { return shared_ptr<const CFG>(shared_from_this(), &cfg); }
+
+    // Parser on this grammar with its lexer, keeps the grammar alive
+    Parser makeParser() const {
+        Parser parser(shareCfg());
+        parser.setLexer(&lexer);
+        return parser;
+    }
+};
+
+// Named grammars (dialects) compiled once and shared. Lookups copy out the current
+// shared_ptr; publishing a new version is an atomic pointer store into the name's slot,
+// so parses already running finish on the version they started with and the old one
+// is freed when its last parser lets go. The name -> slot map is only locked
+// exclusively when a name is added or removed.
+class GrammarRegistry {
+private:
+    struct Slot {
+        shared_ptr<const CompiledGrammar> grammar;   // only accessed through atomic_load/atomic_store
+    };
+
+    mutable shared_mutex lock;
+    map<string, shared_ptr<Slot>> slots;
+    long long nextGeneration = 1;       // guarded by lock
+
+    shared_ptr<Slot> findSlot(const string& name) const;
+
+public:
+    // Runs the whole analysis pipeline (or loads it from the .ll1 cache next to the
+    // grammar), nullptr if the grammar can't be read or is empty
+    shared_ptr<const CompiledGrammar> compile(const string& name, const string& grammarFile, bool useCache = true);
+
+    // Compiles and publishes under name, replacing any earlier version. False (and the
+    // old version stays) if the grammar can't be compiled
+    bool load(const string& name, const string& grammarFile, bool useCache = true);
+
+    // Recompiles name from its grammar file, e.g. after the file changed
+    bool reload(const string& name, bool useCache = true);
+
+    // Atomically makes grammar the current version of name
+    void publish(const string& name, shared_ptr<const CompiledGrammar> grammar);
+
+    // Current version, nullptr if there is no such grammar
+    shared_ptr<const CompiledGrammar> get(const string& name) const;
+
+    bool remove(const string& name);
+    vector<string> names() const;
+};
+
+#endif // GRAMMAR_REGISTRY_H
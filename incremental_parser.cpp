@@ -0,0 +1,256 @@
+#include "incremental_parser.h"
+
+static bool isSpace(char c) {
+    return isspace((unsigned char)c) != 0;
+}
+
+IncrementalParser::IncrementalParser(const CFG* grammar, SymbolId sync) : cfg(grammar), syncSymbol(sync) {}
+
+IncrementalParser::IncrementalParser(const CFG* grammar, const string& syncName) : cfg(grammar) {
+    syncSymbol = cfg->getSymbols().lookup(syncName);
+    if (syncSymbol == NO_SYMBOL || !cfg->getSymbols().isNonTerminal(syncSymbol)) {
+        syncSymbol = cfg->getStartSymbolId();    // only one checkpoint: every edit is a full reparse
+    }
+}
+
+void IncrementalParser::scanInto(string_view segment, size_t baseOffset, vector<Token>& out) const {
+    size_t first = out.size();
+    if (lexer) {
+        lexer->scan(segment, out);
+    } else {
+        const SymbolTable& symbols = cfg->getSymbols();
+        TokenScanner::scan(segment, out);
+        for (size_t i = first; i < out.size(); i++) {
+            out[i].id = symbols.lookupTerminal(segment.substr(out[i].offset, out[i].length));
+        }
+    }
+    for (size_t i = first; i < out.size(); i++) {
+        out[i].offset += baseOffset;
+    }
+}
+
+string IncrementalParser::getText() const {
+    string document(text.size(), '\0');
+    for (size_t i = 0; i < document.size(); i++) {
+        document[i] = text[i];
+    }
+    return document;
+}
+
+vector<Token> IncrementalParser::getTokens() const {
+    vector<Token> result(tokens.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        result[i] = tokens[i];
+        result[i].offset = tokenOffset(i);
+    }
+    return result;
+}
+
+// Both only valid while the sizes the tail is relative to haven't changed yet
+void IncrementalParser::moveTokenGap(size_t position) {
+    uint32_t textSize = text.size();
+    tokens.moveGap(position, [&](Token& token) { token.offset += textSize; },
+                             [&](Token& token) { token.offset -= textSize; });
+}
+
+void IncrementalParser::moveCheckpointGap(size_t position) {
+    int tokenCount = tokens.size(), errorCount = result.errors.size();
+    checkpoints.moveGap(position,
+                        [&](Checkpoint& cp) { cp.tokenIndex += tokenCount; cp.errorCount += errorCount; },
+                        [&](Checkpoint& cp) { cp.tokenIndex -= tokenCount; cp.errorCount -= errorCount; });
+}
+
+const ParseResult& IncrementalParser::parse(string document) {
+    text.assign(vector<char>(document.begin(), document.end()));
+    vector<Token> scannedTokens;
+    scanInto(document, 0, scannedTokens);
+    tokens.assign(move(scannedTokens));
+    checkpoints.clear();
+    result.errors.clear();
+
+    stats = Stats();
+    stats.relexedTokens = tokens.size();
+    reparse({0, 0, {END_MARKER, cfg->getStartSymbolId()}}, 0, 0, 0);
+    return result;
+}
+
+const ParseResult& IncrementalParser::edit(size_t offset, size_t removed, string_view inserted) {
+    offset = min(offset, text.size());
+    removed = min(removed, text.size() - offset);
+    long long byteDelta = (long long)inserted.size() - (long long)removed;
+
+    // Re-lex the whitespace delimited run(s) the edit touches: whitespace is always a
+    // token boundary, so tokens outside [relexStart, relexEnd) stay exactly as they were.
+    // The bytes before offset are the same before and after the edit
+    size_t relexStart = offset;
+    while (relexStart > 0 && !isSpace(text[relexStart - 1])) relexStart--;
+
+    size_t low = 0, high = tokens.size();       // first token at or after relexStart
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (tokenOffset(middle) < relexStart) low = middle + 1;
+        else high = middle;
+    }
+    int first = low;
+
+    // Last checkpoint before the first changed token. Not one at that token: the
+    // expansions that led to a checkpoint already looked at its token
+    low = 0, high = checkpoints.size();
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (checkpointToken(middle) < first) low = middle + 1;
+        else high = middle;
+    }
+    int from = (int)low - 1;
+
+    // Gaps to the edit while the sizes the tails are relative to are still the old ones
+    moveCheckpointGap(from + 1);
+    moveTokenGap(first);
+    text.moveGap(offset, [](char) {}, [](char) {});
+    text.eraseAfter(removed);
+    for (char c : inserted) {
+        text.insert(c);
+    }
+
+    size_t relexEnd = offset + inserted.size();
+    while (relexEnd < text.size() && !isSpace(text[relexEnd])) relexEnd++;
+
+    // Old tokens in the re-lexed run sit right behind the token gap. Compared in old
+    // coordinates, the ones inside the removed bytes have no new offset
+    int erased = 0;
+    uint32_t oldTextSize = text.size() - byteDelta;
+    while (tokens.gap() < tokens.size() && (long long)(tokens[tokens.gap()].offset + oldTextSize) < (long long)relexEnd - byteDelta) {
+        tokens.eraseAfter(1);
+        erased++;
+    }
+    segment.assign(relexEnd - relexStart, '\0');
+    for (size_t i = relexStart; i < relexEnd; i++) {
+        segment[i - relexStart] = text[i];
+    }
+    scanned.clear();
+    scanInto(segment, relexStart, scanned);
+    for (const Token& token : scanned) {
+        tokens.insert(token);
+    }
+    int tokenDelta = (int)scanned.size() - erased;
+    int newEnd = first + scanned.size();
+
+    stats = Stats();
+    stats.relexedTokens = scanned.size();
+    Checkpoint restart = {0, 0, {END_MARKER, cfg->getStartSymbolId()}};
+    if (from >= 0) {
+        restart = move(checkpoints[from]);
+        checkpoints.eraseBefore(1);     // saved again when the parse gets there
+    }
+    reparse(move(restart), newEnd, tokenDelta, byteDelta);
+    return result;
+}
+
+void IncrementalParser::reparse(Checkpoint restart, int newEnd, int tokenDelta, long long byteDelta) {
+    // New errors go to newErrors until it is known which old ones they replace
+    vector<ParseError>& errors = result.errors;
+    vector<SymbolId>& stack = restart.stack;
+    int pos = restart.tokenIndex;
+    int keptErrors = restart.errorCount;
+    newErrors.clear();
+    stats.restartToken = pos;
+
+    int tokenCount = tokens.size();
+    bool inErrorRecoveryMode = false;
+
+    auto offsetOf = [&](int index) {
+        return index < tokenCount ? (int)tokenOffset(index) : (int)text.size();
+    };
+    auto recordError = [&](ParseErrorKind kind, SymbolId expected, SymbolId found) {
+        if (!inErrorRecoveryMode) {
+            newErrors.push_back({kind, pos, offsetOf(pos), expected, found});
+            inErrorRecoveryMode = true;
+        }
+    };
+
+    while (!stack.empty()) {
+        SymbolId token = pos < tokenCount ? tokens[pos].id : END_MARKER;
+        SymbolId top = stack.back();
+
+        if (top == syncSymbol && !inErrorRecoveryMode) {
+            // Same state as before the edit at the same (shifted) place: the rest of the
+            // parse would repeat the old one, which is still behind the checkpoint gap
+            if (pos >= newEnd) {
+                size_t gap = checkpoints.gap();
+                while (gap < checkpoints.size() && checkpointToken(gap) < pos) {
+                    checkpoints.eraseAfter(1);
+                }
+                for (size_t k = gap; k < checkpoints.size() && checkpointToken(k) == pos; k++) {
+                    if (checkpoints[k].stack != stack) {
+                        continue;
+                    }
+                    // Splice the new errors in for the old ones up to the match, the
+                    // ones after it only move
+                    int oldErrorBase = checkpointErrors(k);
+                    checkpoints.eraseAfter(k - gap);
+                    errors.erase(errors.begin() + keptErrors, errors.begin() + oldErrorBase);
+                    errors.insert(errors.begin() + keptErrors, newErrors.begin(), newErrors.end());
+                    for (size_t i = keptErrors + newErrors.size(); i < errors.size(); i++) {
+                        errors[i].tokenIndex += tokenDelta;
+                        errors[i].offset += byteDelta;
+                    }
+                    stats.reconverged = true;
+                    stack.clear();
+                    break;
+                }
+                if (stats.reconverged) {
+                    break;
+                }
+            }
+            checkpoints.insert({pos, keptErrors + (int)newErrors.size(), stack});
+        }
+        stats.steps++;
+
+        // Same steps and panic mode recovery as Parser::parseLine
+        if (top == END_MARKER) {
+            if (token != END_MARKER) {
+                recordError(ParseErrorKind::ExpectedEnd, top, token);
+            }
+            stack.clear();
+            pos++;
+        } else if (cfg->isTerminal(top)) {
+            if (top == token) {
+                stack.pop_back();
+                pos++;
+                inErrorRecoveryMode = false;
+            } else {
+                recordError(ParseErrorKind::Mismatch, top, token);
+                stack.pop_back();
+            }
+        } else {
+            int prodIndex = cfg->getParsingTableEntry(top, token);
+            if (prodIndex == TABLE_SYNCH || (prodIndex == TABLE_ERROR && token == END_MARKER)) {
+                recordError(ParseErrorKind::NoEntry, top, token);
+                stack.pop_back();
+            } else if (prodIndex == TABLE_ERROR) {
+                recordError(ParseErrorKind::NoEntry, top, token);
+                pos++;
+            } else {
+                stack.pop_back();
+                SymbolSpan production = cfg->getProductionRhs(prodIndex);
+                for (int i = production.size() - 1; i >= 0; i--) {
+                    stack.push_back(production[i]);
+                }
+                inErrorRecoveryMode = false;
+            }
+        }
+    }
+
+    if (!stats.reconverged) {
+        // Ran to the end: nothing of the old parse after the restart is left
+        checkpoints.eraseAfter(checkpoints.size() - checkpoints.gap());
+        errors.resize(keptErrors);
+        errors.insert(errors.end(), newErrors.begin(), newErrors.end());
+    }
+
+    stats.stopToken = min(pos, tokenCount);
+    result.accepted = errors.empty();
+    result.errorCount = errors.size();
+    result.tokenCount = tokenCount;
+    result.steps = stats.steps;
+}
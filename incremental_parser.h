@@ -0,0 +1,176 @@
+#ifndef INCREMENTAL_PARSER_H
+#define INCREMENTAL_PARSER_H
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parser.h"
+
+using namespace std;
+
+// Sequence with a gap at the last edit: inserting and erasing at the gap is O(1) and
+// moving the gap costs the distance it moves, not the length of the tail. Owners keep
+// the positions stored behind the gap relative to the end of the document, so the
+// tail needs no updates when something in front of it grows or shrinks; toFront and
+// toBack convert an element when the gap moves over it.
+template <typename T>
+class GapBuffer {
+private:
+    vector<T> items;        // [0, gapStart) and [gapEnd, items.size()) are in use
+    size_t gapStart = 0;
+    size_t gapEnd = 0;
+
+    void grow() {
+        size_t tail = items.size() - gapEnd;
+        vector<T> grown(max<size_t>(64, items.size() * 2));
+        move(items.begin(), items.begin() + gapStart, grown.begin());
+        move(items.begin() + gapEnd, items.end(), grown.end() - tail);
+        gapEnd = grown.size() - tail;
+        items.swap(grown);
+    }
+
+public:
+    size_t size() const { return items.size() - (gapEnd - gapStart); }
+    size_t gap() const { return gapStart; }     // index of the first element behind the gap
+
+    const T& operator[](size_t i) const { return items[i < gapStart ? i : i + (gapEnd - gapStart)]; }
+    T& operator[](size_t i) { return items[i < gapStart ? i : i + (gapEnd - gapStart)]; }
+
+    // Takes over values as is, with the gap at the end
+    void assign(vector<T> values) {
+        items = move(values);
+        gapStart = gapEnd = items.size();
+    }
+
+    void clear() {
+        items.clear();
+        gapStart = gapEnd = 0;
+    }
+
+    template <typename ToFront, typename ToBack>
+    void moveGap(size_t position, ToFront toFront, ToBack toBack) {
+        if (position < gapStart) {
+            size_t count = gapStart - position;
+            move_backward(items.begin() + position, items.begin() + gapStart, items.begin() + gapEnd);
+            gapStart -= count;
+            gapEnd -= count;
+            for_each(items.begin() + gapEnd, items.begin() + gapEnd + count, toBack);
+        } else if (position > gapStart) {
+            size_t count = position - gapStart;
+            move(items.begin() + gapEnd, items.begin() + gapEnd + count, items.begin() + gapStart);
+            for_each(items.begin() + gapStart, items.begin() + position, toFront);
+            gapStart += count;
+            gapEnd += count;
+        }
+    }
+
+    void insert(T value) {      // in front of the gap
+        if (gapStart == gapEnd) {
+            grow();
+        }
+        items[gapStart++] = move(value);
+    }
+
+    void eraseBefore(size_t count) {
+        for (; count > 0; count--) items[--gapStart] = T();
+    }
+
+    void eraseAfter(size_t count) {
+        for (; count > 0; count--) items[gapEnd++] = T();
+    }
+};
+
+// Keeps a whole document (one sentence of the grammar, newlines are whitespace) parsed
+// across edits, for editor integrations. Every time the parser is about to expand the
+// sync non-terminal (STMT for grammar.txt) outside of error recovery, the stack and
+// token position are saved as a checkpoint; that state only depends on the tokens up
+// to and including that position (the lookahead). An edit re-lexes just the touched
+// tokens, restarts from the last checkpoint before them and stops at the first
+// checkpoint past the edit whose stack equals the one saved there before: from there
+// on the old parse is reused as is.
+//
+// Text, tokens and checkpoints are gap buffers with the gap at the last edit. Token
+// offsets and checkpoint positions behind it are stored relative to the end of the
+// text / token list / error list, so the untouched tail shifts for free and an edit
+// costs the re-parsed part plus the distance from the previous edit (and the errors
+// behind the edit, which getResult() hands out with plain positions).
+class IncrementalParser {
+public:
+    struct Checkpoint {
+        int tokenIndex;             // parsing resumes at this token
+        int errorCount;             // errors recorded before the checkpoint
+        vector<SymbolId> stack;
+    };
+
+    // What the last parse() / edit() did
+    struct Stats {
+        int restartToken = 0;       // token the parse resumed at
+        int stopToken = 0;          // token it stopped at (reconverged or the end)
+        int relexedTokens = 0;
+        long long steps = 0;
+        bool reconverged = false;
+    };
+
+private:
+    const CFG* cfg;
+    const Lexer* lexer = nullptr;
+    SymbolId syncSymbol;
+
+    GapBuffer<char> text;
+    GapBuffer<Token> tokens;            // document tokens (no $), offsets relative to the text's end behind the gap
+    GapBuffer<Checkpoint> checkpoints;  // by token index, relative to the token / error count behind the gap
+    ParseResult result;
+    Stats stats;
+    vector<ParseError> newErrors;       // scratch for reparse()
+    vector<Token> scanned;              // scratch for edit()
+    string segment;
+
+    void scanInto(string_view segment, size_t baseOffset, vector<Token>& out) const;
+
+    uint32_t tokenOffset(size_t index) const {
+        return index < tokens.gap() ? tokens[index].offset : tokens[index].offset + (uint32_t)text.size();
+    }
+    int checkpointToken(size_t index) const {
+        return index < checkpoints.gap() ? checkpoints[index].tokenIndex
+                                         : checkpoints[index].tokenIndex + (int)tokens.size();
+    }
+    int checkpointErrors(size_t index) const {
+        return index < checkpoints.gap() ? checkpoints[index].errorCount
+                                         : checkpoints[index].errorCount + (int)result.errors.size();
+    }
+    void moveTokenGap(size_t position);
+    void moveCheckpointGap(size_t position);
+
+    // Parses from restart (the state before token restart.tokenIndex) to the end, or until
+    // a state matches one of the old checkpoints behind the gap past token newEnd. The
+    // errors before restart.errorCount are kept, the rest up to the match replaced
+    void reparse(Checkpoint restart, int newEnd, int tokenDelta, long long byteDelta);
+
+public:
+    // sync is the non-terminal whose expansions are the checkpoints
+    IncrementalParser(const CFG* grammar, SymbolId sync);
+    // Same, looking the sync non-terminal up by name (the start symbol if it isn't one)
+    IncrementalParser(const CFG* grammar, const string& syncName = "STMT");
+
+    // Tokenize with the grammar's DFA lexer instead of whitespace splitting, call before parse()
+    void setLexer(const Lexer* lex) { lexer = lex; }
+
+    // Full parse of a new document
+    const ParseResult& parse(string document);
+
+    // Replaces removed bytes at offset with inserted and reparses incrementally. Error
+    // token indices and offsets refer to the edited document
+    const ParseResult& edit(size_t offset, size_t removed, string_view inserted);
+
+    const ParseResult& getResult() const { return result; }
+    const Stats& getStats() const { return stats; }
+    size_t getCheckpointCount() const { return checkpoints.size(); }
+    size_t getTokenCount() const { return tokens.size(); }
+
+    // Copies of the document and its tokens (linear, meant for checks and tools)
+    string getText() const;
+    vector<Token> getTokens() const;
+};
+
+#endif // INCREMENTAL_PARSER_H
@@ -0,0 +1,145 @@
+#include "lexer.h"
+
+Lexer::Lexer(const CFG& cfg) {
+    const SymbolTable& symbols = cfg.getSymbols();
+
+    // Step 1: trie over the terminal spellings. Children are always created after their
+    // parent, so every edge goes from a lower to a higher state number
+    vector<map<unsigned char, int>> trie(1);
+    vector<SymbolId> trieAccept(1, NO_SYMBOL);
+    for (SymbolId id = 0; id < symbols.size(); id++) {
+        if (!symbols.isTerminal(id) || id == END_MARKER) {
+            continue;
+        }
+        int state = 0;
+        for (unsigned char c : symbols.name(id)) {
+            auto it = trie[state].find(c);
+            if (it == trie[state].end()) {
+                trie[state][c] = trie.size();
+                state = trie.size();
+                trie.emplace_back();
+                trieAccept.push_back(NO_SYMBOL);
+            } else {
+                state = it->second;
+            }
+        }
+        trieAccept[state] = id;
+    }
+
+    // Step 2: minimize. The trie is acyclic, so going from the leaves up, two states are
+    // equivalent exactly when they accept the same terminal and have the same edges
+    // into already merged states
+    vector<int> merged(trie.size());
+    map<vector<int>, int> signatures;
+    for (int state = trie.size() - 1; state >= 0; state--) {
+        vector<int> signature;
+        signature.push_back(trieAccept[state]);
+        for (const auto& edge : trie[state]) {
+            signature.push_back(edge.first);
+            signature.push_back(merged[edge.second]);
+        }
+        auto it = signatures.find(signature);
+        if (it == signatures.end()) {
+            it = signatures.emplace(signature, signatures.size()).first;
+        }
+        merged[state] = it->second;
+    }
+
+    // Number the merged states breadth first from the root so START_STATE is 0
+    int mergedCount = signatures.size();
+    vector<int> number(mergedCount, -1);
+    vector<int> representative;     // new state -> one trie state it came from
+    number[merged[0]] = 0;
+    representative.push_back(0);
+    for (size_t i = 0; i < representative.size(); i++) {
+        for (const auto& edge : trie[representative[i]]) {
+            int target = merged[edge.second];
+            if (number[target] < 0) {
+                number[target] = representative.size();
+                representative.push_back(edge.second);
+            }
+        }
+    }
+    stateCount = representative.size();
+
+    // Step 3: byte classes. Two bytes are interchangeable if they lead to the same state
+    // from every state, so the table only needs one column per class
+    map<vector<int32_t>, int> columns;
+    for (int c = 0; c < 256; c++) {
+        vector<int32_t> column(stateCount, -1);
+        for (int state = 0; state < stateCount; state++) {
+            auto it = trie[representative[state]].find((unsigned char)c);
+            if (it != trie[representative[state]].end()) {
+                column[state] = number[merged[it->second]];
+            }
+        }
+        auto it = columns.find(column);
+        if (it == columns.end()) {
+            it = columns.emplace(column, columns.size()).first;
+        }
+        byteClass[c] = it->second;
+    }
+    classCount = columns.size();
+
+    // Step 4: flatten into the transition table
+    transitions.assign(stateCount * classCount, -1);
+    for (const auto& column : columns) {
+        for (int state = 0; state < stateCount; state++) {
+            transitions[state * classCount + column.second] = column.first[state];
+        }
+    }
+    accepting.resize(stateCount);
+    for (int state = 0; state < stateCount; state++) {
+        accepting[state] = trieAccept[representative[state]];
+    }
+}
+
+void Lexer::scan(string_view text, vector<Token>& out) const {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    size_t length = text.size();
+    size_t pos = 0;
+
+    while (pos < length) {
+        if (isSpace(bytes[pos])) {
+            pos++;
+            continue;
+        }
+
+        // Run the DFA as far as it goes, remembering the last accepting position
+        int state = START_STATE;
+        SymbolId matched = NO_SYMBOL;
+        size_t matchEnd = pos;
+        for (size_t i = pos; i < length; i++) {
+            state = transitions[state * classCount + byteClass[bytes[i]]];
+            if (state < 0) {
+                break;
+            }
+            if (accepting[state] != NO_SYMBOL) {
+                matched = accepting[state];
+                matchEnd = i + 1;
+            }
+        }
+
+        // "intx" is one unknown word, not int followed by x
+        if (matched != NO_SYMBOL && matchEnd < length && isWord(bytes[matchEnd - 1]) && isWord(bytes[matchEnd])) {
+            size_t end = wordEnd(bytes, matchEnd, length);
+            out.push_back({NO_SYMBOL, (uint32_t)pos, (uint32_t)(end - pos)});
+            pos = end;
+            continue;
+        }
+        if (matched != NO_SYMBOL) {
+            out.push_back({matched, (uint32_t)pos, (uint32_t)(matchEnd - pos)});
+            pos = matchEnd;
+            continue;
+        }
+
+        // No terminal matches here: one unknown token up to the next whitespace or the
+        // next byte a terminal could start with, a word always as a whole
+        size_t end = isWord(bytes[pos]) ? wordEnd(bytes, pos, length) : pos + 1;
+        while (end < length && !isSpace(bytes[end]) && transitions[START_STATE * classCount + byteClass[bytes[end]]] < 0) {
+            end++;
+        }
+        out.push_back({NO_SYMBOL, (uint32_t)pos, (uint32_t)(end - pos)});
+        pos = end;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CFG.h"
+
+using namespace std;
+
+struct Token {
+    SymbolId id;        // terminal id, NO_SYMBOL for text that matches no terminal
+    uint32_t offset;    // byte offset in the scanned text
+    uint32_t length;
+};
+
+// Table driven scanner built from the terminals the CFG discovered ("int", "==", "(", ...).
+// The terminals are put in a trie, the trie is minimized (equivalent states merged) and
+// flattened into a [state x byte class] transition table. Scanning is one pass over
+// the raw bytes with longest match ("==" wins over "="), no allocation besides the
+// caller's output vector. A match never ends inside a word: "intx" is one unknown
+// token, not int followed by x, the same as the whitespace split.
+class Lexer {
+private:
+    uint8_t byteClass[256];         // bytes that behave the same everywhere share a class
+    int classCount = 0;
+    int stateCount = 0;
+    vector<int32_t> transitions;    // [state * classCount + class] -> next state, -1 = dead
+    vector<SymbolId> accepting;     // state -> terminal it accepts, NO_SYMBOL if none
+
+    static bool isSpace(unsigned char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    // Identifier / keyword bytes: a terminal can't end between two of them
+    static bool isWord(unsigned char c) {
+        return isalnum(c) || c == '_';
+    }
+
+    static size_t wordEnd(const unsigned char* bytes, size_t pos, size_t length) {
+        while (pos < length && isWord(bytes[pos])) pos++;
+        return pos;
+    }
+
+public:
+    static const int START_STATE = 0;
+
+    Lexer(const CFG& cfg);
+
+    // Appends the tokens of text to out (out is not cleared)
+    void scan(string_view text, vector<Token>& out) const;
+
+    int getStateCount() const { return stateCount; }
+    int getClassCount() const { return classCount; }
+};
+
+#endif // LEXER_H
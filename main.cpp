@@ -1,47 +1,348 @@
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
-#include <string> 
+#include <string>
 #include "CFG.h"
-#include "Parser.h"
+#include "parser.h"
+#include "grammar_cache.h"
+#include "result_writer.h"
+#ifndef CFG_NO_METRICS
+#include "alloc_counter.h"
+#endif
 
 using namespace std;
 
-int main() {
-    string grammar_file, input_file;
-    
-    cout << "Enter the grammar file path: ";
-    cin >> grammar_file;
-    
-    cout << "Enter the input file path for parsing: ";
-    cin >> input_file;
+// Command line mode, see printUsage(). Without arguments main() keeps the original
+// interactive prompts and the full step by step output.
+struct Options {
+    string grammarFile;
+    vector<string> inputs;          // "-" = stdin, empty = stdin
+    bool trace = false;
+    bool verbose = false;           // print the grammar analysis steps
+    bool useCache = true;
+    int threads = WorkPool::defaultThreads();
+    ResultFormat format = ResultFormat::Text;
+    TableLayout tableLayout = TableLayout::Dense;
+    string metricsFormat;           // "", "json" or "prometheus"
+    string metricsFile;
+};
 
-    CFG cfg(grammar_file);
+// Metrics asked for (by the flag or variable named) from a build that compiled them out
+static void warnMetricsCompiledOut(const char* how) {
+#ifdef CFG_NO_METRICS
+    cerr << "\033[33mWarning: built with CFG_METRICS=OFF, " << how << " will write no measurements\033[0m" << endl;
+#else
+    (void)how;
+#endif
+}
 
-    cout << "\033[32m\nOriginal CFG:\033[0m\n";
-    cfg.print();
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options] <grammar file> [input files... | -]\n"
+         << "       " << program << "                 (interactive)\n\n"
+         << "Validates every line of the inputs (stdin when none are given) against the grammar.\n\n"
+         << "Options:\n"
+         << "  -f, --format text|jsonl|csv   per line output (default text)\n"
+         << "  -j, --threads N               parallel validation threads (default: all cores)\n"
+         << "  -t, --trace                   print the parsing table of every line (sequential, text only)\n"
+         << "  -v, --verbose                 print the grammar, FIRST/FOLLOW sets and conflicts\n"
+         << "      --no-cache                don't read or write the .ll1 grammar cache\n"
+         << "      --table dense|compressed  parse table layout (compressed: row displacement, for big sparse grammars)\n"
+         << "      --metrics json|prometheus write metrics when done (to stderr or --metrics-file)\n"
+         << "      --metrics-file PATH\n"
+         << "  -h, --help\n\n"
+         << "Exit status: 0 all lines accepted, 1 some rejected, 2 usage or I/O error.\n";
+}
 
-    cout << "\033[32m\nStep 1: Removing Left Recursion\033[0m\n";
-    cfg.LeftRecursion();
-    cfg.print();
+static bool parseArguments(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&](string& out) {
+            if (i + 1 >= argc) {
+                cerr << "\033[31mError: " << arg << " needs a value\033[0m" << endl;
+                return false;
+            }
+            out = argv[++i];
+            return true;
+        };
 
-    cout << "\033[32m\nStep 2: Applying Left Factoring\033[0m\n";
-    cfg.LeftFactoring();
-    cfg.print();
+        string text;
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            exit(0);
+        } else if (arg == "-t" || arg == "--trace") {
+            options.trace = true;
+        } else if (arg == "-v" || arg == "--verbose") {
+            options.verbose = true;
+        } else if (arg == "--no-cache") {
+            options.useCache = false;
+        } else if (arg == "-f" || arg == "--format") {
+            if (!value(text)) return false;
+            if (!ResultWriter::parseFormat(text, options.format)) {
+                cerr << "\033[31mError: Unknown format " << text << "\033[0m" << endl;
+                return false;
+            }
+        } else if (arg == "-j" || arg == "--threads") {
+            if (!value(text)) return false;
+            char* end = nullptr;
+            errno = 0;
+            long threads = strtol(text.c_str(), &end, 10);
+            options.threads = errno == 0 && end != text.c_str() && *end == '\0' && threads <= INT_MAX ? (int)threads : 0;
+            if (options.threads < 1) {
+                cerr << "\033[31mError: Invalid thread count " << text << "\033[0m" << endl;
+                return false;
+            }
+        } else if (arg == "--table") {
+            if (!value(text)) return false;
+            if (text == "dense") {
+                options.tableLayout = TableLayout::Dense;
+            } else if (text == "compressed") {
+                options.tableLayout = TableLayout::Compressed;
+            } else {
+                cerr << "\033[31mError: Unknown table layout " << text << "\033[0m" << endl;
+                return false;
+            }
+        } else if (arg == "--metrics") {
+            if (!value(options.metricsFormat)) return false;
+            if (options.metricsFormat != "json" && options.metricsFormat != "prometheus") {
+                cerr << "\033[31mError: Unknown metrics format " << options.metricsFormat << "\033[0m" << endl;
+                return false;
+            }
+            warnMetricsCompiledOut("--metrics");
+        } else if (arg == "--metrics-file") {
+            if (!value(options.metricsFile)) return false;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            cerr << "\033[31mError: Unknown option " << arg << "\033[0m" << endl;
+            return false;
+        } else if (options.grammarFile.empty()) {
+            options.grammarFile = arg;
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
+    if (options.grammarFile.empty()) {
+        cerr << "\033[31mError: No grammar file given\033[0m" << endl;
+        return false;
+    }
+    return true;
+}
 
-    cout << "\033[32m\nStep 3: Computing FIRST Sets\033[0m\n";
-    cfg.computeFirstSets();
-    cfg.printFirstSets();
+// Metrics text to the given file, or to out when there is none
+static void writeMetrics(const string& format, const string& path, ostream& out) {
+    string text = format == "prometheus" ? Metrics::global().toPrometheus() : Metrics::global().toJson() + "\n";
+    if (!path.empty()) {
+        ofstream file(path);
+        file << text;
+    } else {
+        out << text;
+    }
+}
+
+// Runs the analysis pipeline (or loads it from the cache), printing every step when verbose
+static void loadGrammar(CFG& cfg, const string& grammar_file, bool verbose, bool useCache,
+                        TableLayout layout = TableLayout::Dense) {
+    // Reuse the analysed grammar from the binary cache when the grammar file hasn't changed
+    uint64_t grammarHash = GrammarCache::hashFile(grammar_file);
+    string cacheFile = GrammarCache::cachePath(grammar_file);
 
-    cout << "\033[32m\nStep 4: Computing FOLLOW Sets\033[0m\n";
+    if (useCache && GrammarCache::load(cfg, cacheFile, grammarHash)) {
+        cfg.setTableLayout(layout);
+        if (verbose) {
+            cout << "\033[32m\nLoaded precompiled grammar from " << cacheFile << ":\033[0m\n";
+            cfg.print();
+            cfg.printConflicts();
+        }
+        return;
+    }
+
+    cfg = CFG(grammar_file);
+    if (verbose) {
+        cout << "\033[32m\nOriginal CFG:\033[0m\n";
+        cfg.print();
+        cout << "\033[32m\nStep 1: Removing Left Recursion\033[0m\n";
+    }
+    cfg.LeftRecursion();
+    if (verbose) {
+        cfg.print();
+        cout << "\033[32m\nStep 2: Applying Left Factoring\033[0m\n";
+    }
+    cfg.LeftFactoring();
+    if (verbose) {
+        cfg.print();
+        cout << "\033[32m\nStep 3: Computing FIRST Sets\033[0m\n";
+    }
+    cfg.computeFirstSets();
+    if (verbose) {
+        cfg.printFirstSets();
+        cout << "\033[32m\nStep 4: Computing FOLLOW Sets\033[0m\n";
+    }
     cfg.computeFollowSets();
-    cfg.printFollowSets();
+    if (verbose) {
+        cfg.printFollowSets();
+        cout << "\033[32m\nStep 5: Constructing LL(1) Parsing Table\033[0m\n";
+    }
+    cfg.constructParsingTable(layout);
+    if (verbose) {
+        //cfg.printParsingTable();
+        cfg.printConflicts();
+        cfg.printTableStats();
+    } else if (!cfg.isLL1()) {
+        cerr << "\033[33mWarning: " << cfg.getConflicts().size() << " LL(1) conflict(s) in " << grammar_file
+             << ", run with -v for details\033[0m" << endl;
+    }
+
+    if (useCache) {
+        GrammarCache::save(cfg, cacheFile, grammarHash);
+    }
+}
 
-    cout << "\033[32m\nStep 5: Constructing LL(1) Parsing Table\033[0m\n";
-    cfg.constructParsingTable();
-    //cfg.printParsingTable();
+static int runInteractive() {
+    string grammar_file, input_file;
+    const char* metricsFormat = getenv("CFG_METRICS");
+    if (metricsFormat && *metricsFormat) {
+        Metrics::enable();
+        warnMetricsCompiledOut("CFG_METRICS");
+    }
+
+    cout << "Enter the grammar file path: ";
+    cin >> grammar_file;
+
+    cout << "Enter the input file path for parsing: ";
+    cin >> input_file;
+
+    CFG cfg;
+    loadGrammar(cfg, grammar_file, true, true);
+
+    // Scanner for the input, built from the grammar's terminals
+    Lexer lexer(cfg);
 
     // Create parser and parse input file
     Parser parser(&cfg);
+    parser.setLexer(&lexer);
     parser.parseFile(input_file);
 
+    // CFG_METRICS=json or CFG_METRICS=prometheus turns on instrumentation, the metrics go
+    // to the file named by CFG_METRICS_FILE (stdout if unset) when the run is done
+    if (Metrics::enabled()) {
+        const char* path = getenv("CFG_METRICS_FILE");
+        cout << "\n";
+        writeMetrics(metricsFormat, path ? path : "", cout);
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+static int runBatch(const Options& options) {
+    if (!options.metricsFormat.empty()) {
+        Metrics::enable();
+    }
+
+    ifstream probe(options.grammarFile);
+    if (!probe.is_open()) {
+        cerr << "\033[31mError: Unable to open grammar file " << options.grammarFile << "\033[0m" << endl;
+        return 2;
+    }
+    probe.close();
+
+    CFG cfg;
+    loadGrammar(cfg, options.grammarFile, options.verbose, options.useCache, options.tableLayout);
+    Lexer lexer(cfg);
+    Parser parser(&cfg);
+    parser.setLexer(&lexer);
+
+    ios::sync_with_stdio(false);
+    ResultWriter writer(&cfg, options.trace ? ResultFormat::Text : options.format, cout);
+    writer.writeHeader();
+
+    long long rejected = 0;
+    bool ioError = false;
+    vector<ParseResult> results;
+
+    // Lines go through the parser in batches so the memory for results stays bounded
+    const size_t batchSize = 1 << 16;
+    auto runBatchOfLines = [&](const string& source, const vector<string_view>& lines, int firstLineNum) {
+        if (options.trace) {
+            writer.flush();
+            for (size_t i = 0; i < lines.size(); i++) {
+                cout << "\n\033[1;33m" << source << ": Parsing Line " << firstLineNum + i << ": \"" << lines[i] << "\"\033[0m\n";
+                parser.parseString(lines[i], firstLineNum + i);
+            }
+            cout.flush();
+            return;
+        }
+        parser.parseLines(lines, firstLineNum, options.threads, results);
+        for (size_t i = 0; i < results.size(); i++) {
+            if (!results[i].accepted) rejected++;
+            writer.write(source, firstLineNum + i, results[i]);
+        }
+    };
+
+    vector<string> inputs = options.inputs;
+    if (inputs.empty()) {
+        inputs.push_back("-");
+    }
+    for (const string& input : inputs) {
+        vector<string_view> lines;
+        if (input == "-") {
+            // stdin can't be mapped: keep a batch of lines alive, parse, reuse
+            vector<string> storage;
+            string line;
+            int lineNum = 1;
+            while (true) {
+                bool more = bool(getline(cin, line));
+                if (more) {
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    storage.push_back(move(line));
+                }
+                if (storage.size() == batchSize || (!more && !storage.empty())) {
+                    lines.assign(storage.begin(), storage.end());
+                    runBatchOfLines("<stdin>", lines, lineNum);
+                    lineNum += storage.size();
+                    storage.clear();
+                }
+                if (!more) break;
+            }
+            continue;
+        }
+
+        MappedFile file;
+        if (!file.open(input)) {
+            cerr << "\033[31mError: Unable to open input file " << input << "\033[0m" << endl;
+            ioError = true;
+            continue;
+        }
+        int firstLineNum = 1;
+        forEachLine(file.view(), [&](string_view line, int lineNum) {
+            lines.push_back(line);
+            if (lines.size() == batchSize) {
+                runBatchOfLines(input, lines, firstLineNum);
+                firstLineNum = lineNum + 1;
+                lines.clear();
+            }
+        });
+        if (!lines.empty()) {
+            runBatchOfLines(input, lines, firstLineNum);
+        }
+    }
+    writer.flush();
+
+    if (Metrics::enabled()) {
+        writeMetrics(options.metricsFormat, options.metricsFile, cerr);
+    }
+    if (ioError) {
+        return 2;
+    }
+    return (options.trace ? parser.getErrorCount() > 0 : rejected > 0) ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        return runInteractive();
+    }
+
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    return runBatch(options);
+}
@@ -0,0 +1,143 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Read-only view of a whole file. On POSIX the file is memory mapped so tokens can be
+// string_view slices straight into the page cache (no getline / istringstream copies).
+// Pipes and other non-regular files, and other platforms, are read into one buffer.
+class MappedFile {
+private:
+    const char* begin = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    string buffer;      // fallback storage when mmap isn't available
+
+public:
+    MappedFile() {}
+
+    MappedFile(const string& filename) {
+        open(filename);
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const string& filename) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        // Only a non-empty regular file is mapped. Pipes, FIFOs and /dev/stdin report a
+        // size of 0 whatever they hold, so they (and a failed mmap) are read instead, from
+        // this descriptor: opening a FIFO a second time could miss its writer
+        struct stat info = {};
+        bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+        if (regular && info.st_size == 0) {
+            ::close(fd);
+            return true;    // empty file, nothing to map
+        }
+        if (regular) {
+            void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, info.st_size, MADV_SEQUENTIAL);
+                begin = static_cast<const char*>(addr);
+                length = info.st_size;
+                mapped = true;
+                ::close(fd);
+                return true;
+            }
+        }
+        char chunk[1 << 16];
+        while (true) {
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                ::close(fd);
+                if (n < 0) {
+                    buffer.clear();
+                    return false;
+                }
+                break;
+            }
+            buffer.append(chunk, n);
+        }
+        begin = buffer.data();
+        length = buffer.size();
+        return true;
+#else
+        ifstream file(filename, ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        stringstream contents;
+        contents << file.rdbuf();
+        buffer = contents.str();
+        begin = buffer.data();
+        length = buffer.size();
+        return true;
+#endif
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (mapped) {
+            munmap(const_cast<char*>(begin), length);
+        }
+#endif
+        begin = nullptr;
+        length = 0;
+        mapped = false;
+        buffer.clear();
+    }
+
+    string_view view() const {
+        return string_view(begin, length);
+    }
+
+    const char* data() const { return begin; }
+    size_t size() const { return length; }
+};
+
+// Splits a buffer into lines the same way getline does (no empty line after a final
+// '\n'), a trailing '\r' is dropped. Calls fn(line, lineNum) with 1-based line numbers.
+template <typename Fn>
+void forEachLine(string_view text, Fn fn) {
+    size_t pos = 0;
+    int lineNum = 1;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == string_view::npos) {
+            end = text.size();
+        }
+        string_view line = text.substr(pos, end - pos);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        fn(line, lineNum++);
+        pos = end + 1;
+    }
+}
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,265 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+// Process wide counters, high-water gauges and latency timers for the CFG pipeline
+// and the parser. Everything is off until Metrics::enable(); the METRIC_* macros then
+// cost one relaxed load and a branch, and compiling with CFG_NO_METRICS removes them
+// entirely. Recording is lock free, so parallel parsers can share the metrics.
+
+// Bumped by the operator new in alloc_counter.h when a program includes it
+inline atomic<long long> allocationCount{0};
+
+class Counter {
+private:
+    atomic<long long> value{0};
+
+public:
+    void add(long long n) { value.fetch_add(n, memory_order_relaxed); }
+    long long get() const { return value.load(memory_order_relaxed); }
+    void reset() { value.store(0, memory_order_relaxed); }
+};
+
+// Last or largest value seen (stack high-water mark, table size, ...)
+class Gauge {
+private:
+    atomic<long long> value{0};
+
+public:
+    void set(long long v) { value.store(v, memory_order_relaxed); }
+
+    void observeMax(long long v) {
+        long long current = value.load(memory_order_relaxed);
+        while (v > current && !value.compare_exchange_weak(current, v, memory_order_relaxed)) {}
+    }
+
+    long long get() const { return value.load(memory_order_relaxed); }
+    void reset() { value.store(0, memory_order_relaxed); }
+};
+
+// Durations in power of two nanosecond buckets, enough for p50/p99 within a factor of 2
+class Timer {
+public:
+    static const int BUCKETS = 40;      // up to 2^40 ns, about 18 minutes
+
+private:
+    atomic<long long> count{0};
+    atomic<long long> totalNs{0};
+    atomic<long long> maxNs{0};
+    atomic<long long> allocations{0};
+    atomic<long long> buckets[BUCKETS] = {};
+
+public:
+    void record(long long ns, long long allocated = 0) {
+        count.fetch_add(1, memory_order_relaxed);
+        totalNs.fetch_add(ns, memory_order_relaxed);
+        allocations.fetch_add(allocated, memory_order_relaxed);
+        long long current = maxNs.load(memory_order_relaxed);
+        while (ns > current && !maxNs.compare_exchange_weak(current, ns, memory_order_relaxed)) {}
+        int bucket = 0;
+        while (bucket < BUCKETS - 1 && (1LL << bucket) < ns) bucket++;
+        buckets[bucket].fetch_add(1, memory_order_relaxed);
+    }
+
+    long long getCount() const { return count.load(memory_order_relaxed); }
+    long long getTotalNs() const { return totalNs.load(memory_order_relaxed); }
+    long long getMaxNs() const { return maxNs.load(memory_order_relaxed); }
+    long long getAllocations() const { return allocations.load(memory_order_relaxed); }
+    long long getBucket(int bucket) const { return buckets[bucket].load(memory_order_relaxed); }
+    static long long bucketLimitNs(int bucket) { return 1LL << bucket; }
+
+    // Upper bound of the bucket holding the q-th quantile
+    long long quantileNs(double q) const {
+        long long total = getCount();
+        if (total == 0) return 0;
+        long long rank = (long long)(q * total);
+        long long seen = 0;
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            seen += getBucket(bucket);
+            if (seen > rank) return min(bucketLimitNs(bucket), getMaxNs());
+        }
+        return getMaxNs();
+    }
+
+    void reset() {
+        count = 0;
+        totalNs = 0;
+        maxNs = 0;
+        allocations = 0;
+        for (auto& bucket : buckets) bucket = 0;
+    }
+};
+
+class Metrics {
+private:
+    inline static atomic<bool> on{false};
+
+    mutable mutex lock;     // only guards registration and export, not recording
+    deque<Counter> counterStore;
+    deque<Gauge> gaugeStore;
+    deque<Timer> timerStore;
+    map<string, Counter*> counters;
+    map<string, Gauge*> gauges;
+    map<string, Timer*> timers;
+
+    template <class T>
+    static T& find(map<string, T*>& index, deque<T>& store, const string& name) {
+        auto it = index.find(name);
+        if (it != index.end()) return *it->second;
+        store.emplace_back();
+        index[name] = &store.back();
+        return store.back();
+    }
+
+public:
+    static Metrics& global() {
+        static Metrics instance;
+        return instance;
+    }
+
+    static bool enabled() { return on.load(memory_order_relaxed); }
+    static void enable(bool value = true) { on.store(value, memory_order_relaxed); }
+
+    // Names should be valid Prometheus names ([a-z_][a-z0-9_]*); the references stay valid
+    Counter& counter(const string& name) {
+        lock_guard<mutex> guard(lock);
+        return find(counters, counterStore, name);
+    }
+
+    Gauge& gauge(const string& name) {
+        lock_guard<mutex> guard(lock);
+        return find(gauges, gaugeStore, name);
+    }
+
+    Timer& timer(const string& name) {
+        lock_guard<mutex> guard(lock);
+        return find(timers, timerStore, name);
+    }
+
+    void reset() {
+        lock_guard<mutex> guard(lock);
+        for (auto& entry : counters) entry.second->reset();
+        for (auto& entry : gauges) entry.second->reset();
+        for (auto& entry : timers) entry.second->reset();
+    }
+
+    string toJson() const {
+        lock_guard<mutex> guard(lock);
+        ostringstream out;
+        out << "{\"counters\":{";
+        const char* separator = "";
+        for (const auto& entry : counters) {
+            out << separator << "\"" << entry.first << "\":" << entry.second->get();
+            separator = ",";
+        }
+        out << "},\"gauges\":{";
+        separator = "";
+        for (const auto& entry : gauges) {
+            out << separator << "\"" << entry.first << "\":" << entry.second->get();
+            separator = ",";
+        }
+        out << "},\"timers\":{";
+        separator = "";
+        for (const auto& entry : timers) {
+            const Timer& t = *entry.second;
+            out << separator << "\"" << entry.first << "\":{\"count\":" << t.getCount()
+                << ",\"total_ns\":" << t.getTotalNs() << ",\"max_ns\":" << t.getMaxNs()
+                << ",\"p50_ns\":" << t.quantileNs(0.5) << ",\"p99_ns\":" << t.quantileNs(0.99)
+                << ",\"allocations\":" << t.getAllocations() << "}";
+            separator = ",";
+        }
+        out << "}}";
+        return out.str();
+    }
+
+    // Text exposition format: counters as *_total, timers as *_seconds histograms
+    string toPrometheus() const {
+        lock_guard<mutex> guard(lock);
+        ostringstream out;
+        for (const auto& entry : counters) {
+            out << "# TYPE " << entry.first << "_total counter\n";
+            out << entry.first << "_total " << entry.second->get() << "\n";
+        }
+        for (const auto& entry : gauges) {
+            out << "# TYPE " << entry.first << " gauge\n";
+            out << entry.first << " " << entry.second->get() << "\n";
+        }
+        for (const auto& entry : timers) {
+            const Timer& t = *entry.second;
+            string name = entry.first + "_seconds";
+            out << "# TYPE " << name << " histogram\n";
+            long long cumulative = 0;
+            for (int bucket = 0; bucket < Timer::BUCKETS; bucket++) {
+                if (t.getBucket(bucket) == 0 && bucket + 1 < Timer::BUCKETS) continue;   // keep it short
+                cumulative += t.getBucket(bucket);
+                out << name << "_bucket{le=\"" << Timer::bucketLimitNs(bucket) / 1e9 << "\"} " << cumulative << "\n";
+            }
+            out << name << "_bucket{le=\"+Inf\"} " << t.getCount() << "\n";
+            out << name << "_sum " << t.getTotalNs() / 1e9 << "\n";
+            out << name << "_count " << t.getCount() << "\n";
+            out << "# TYPE " << entry.first << "_allocations_total counter\n";
+            out << entry.first << "_allocations_total " << t.getAllocations() << "\n";
+        }
+        return out.str();
+    }
+};
+
+// Times its scope into a Timer, along with the allocations made meanwhile (counted
+// process wide, so other threads' allocations are included)
+class ScopedTimer {
+private:
+    Timer* timer = nullptr;
+    chrono::steady_clock::time_point started;
+    long long allocationsBefore = 0;
+
+public:
+    explicit ScopedTimer(Timer& target) {
+        if (Metrics::enabled()) {
+            timer = &target;
+            allocationsBefore = allocationCount.load(memory_order_relaxed);
+            started = chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer() {
+        if (timer) {
+            long long ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count();
+            timer->record(ns, allocationCount.load(memory_order_relaxed) - allocationsBefore);
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+#define METRIC_JOIN2(a, b) a##b
+#define METRIC_JOIN(a, b) METRIC_JOIN2(a, b)
+
+#ifndef CFG_NO_METRICS
+// The metric itself is looked up once per call site
+#define METRIC_TIMER(name) \
+    static Timer& METRIC_JOIN(metricTimer_, __LINE__) = Metrics::global().timer(name); \
+    ScopedTimer METRIC_JOIN(metricScope_, __LINE__)(METRIC_JOIN(metricTimer_, __LINE__))
+#define METRIC_COUNT(name, n) \
+    do { if (Metrics::enabled()) { static Counter& metric = Metrics::global().counter(name); metric.add(n); } } while (0)
+#define METRIC_MAX(name, v) \
+    do { if (Metrics::enabled()) { static Gauge& metric = Metrics::global().gauge(name); metric.observeMax(v); } } while (0)
+#define METRIC_SET(name, v) \
+    do { if (Metrics::enabled()) { static Gauge& metric = Metrics::global().gauge(name); metric.set(v); } } while (0)
+#else
+#define METRIC_TIMER(name) do {} while (0)
+#define METRIC_COUNT(name, n) do {} while (0)
+#define METRIC_MAX(name, v) do {} while (0)
+#define METRIC_SET(name, v) do {} while (0)
+#endif
+
+#endif // METRICS_H
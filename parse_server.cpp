@@ -0,0 +1,417 @@
+#include "parse_server.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "metrics.h"
+#include "result_writer.h"
+
+// The I/O thread stops reading new requests while this many are queued, so clients
+// that send faster than the workers parse can't grow the queue without bound
+static const size_t MAX_QUEUED = 1 << 16;
+
+// Per connection the same goes for its queued requests and for responses it hasn't
+// read yet: past either cap the connection isn't read until it catches up
+static const int MAX_CONNECTION_QUEUED = 4096;
+static const size_t MAX_UNSENT = 1 << 20;
+
+// How long stop() keeps writing out responses before it cuts the clients off
+static const chrono::milliseconds STOP_GRACE(1000);
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+ParseServer::Connection::~Connection() {
+    close(fd);
+}
+
+void ParseServer::Connection::flushLocked() {
+    while (unsent() > 0 && !closed) {
+        ssize_t n = ::send(fd, outbox.data() + sent, unsent(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                closed = true;      // client went away, drop its remaining responses
+            }
+            break;
+        }
+        sent += n;
+    }
+    if (sent == outbox.size() || closed) {
+        outbox.clear();
+        sent = 0;
+    } else if (sent >= outbox.size() / 2) {
+        outbox.erase(0, sent);
+        sent = 0;
+    }
+}
+
+ParseServer::ParseServer(GrammarRegistry& grammars, ServerOptions serverOptions)
+    : registry(grammars), options(move(serverOptions)) {
+    options.threads = max(1, options.threads);
+    options.maxBatch = max(1, options.maxBatch);
+}
+
+bool ParseServer::start() {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (options.socketPath.empty() || options.socketPath.size() >= sizeof(address.sun_path)) {
+        cerr << "\033[31mError: Invalid socket path " << options.socketPath << "\033[0m" << endl;
+        return false;
+    }
+    memcpy(address.sun_path, options.socketPath.c_str(), options.socketPath.size());
+
+    if (pipe(wakeFds) < 0 || !setNonBlocking(wakeFds[0]) || !setNonBlocking(wakeFds[1])) {
+        cerr << "\033[31mError: pipe: " << strerror(errno) << "\033[0m" << endl;
+        return false;
+    }
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        cerr << "\033[31mError: socket: " << strerror(errno) << "\033[0m" << endl;
+        return false;
+    }
+    unlink(options.socketPath.c_str());     // stale socket of an earlier run
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 128) < 0 ||
+        !setNonBlocking(listenFd)) {
+        cerr << "\033[31mError: Unable to listen on " << options.socketPath << ": " << strerror(errno) << "\033[0m" << endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    stopping = false;
+    workersDone = false;
+    drained = false;
+    for (int i = 0; i < options.threads; i++) {
+        workers.emplace_back(&ParseServer::workerLoop, this);
+    }
+    io = thread(&ParseServer::ioLoop, this);
+    return true;
+}
+
+void ParseServer::stop() {
+    if (listenFd < 0 || stopping.exchange(true)) {
+        return;
+    }
+
+    // The I/O thread stops accepting and reading and tells the workers no more requests
+    // are coming; they answer what is queued and exit
+    wake();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    // Then it writes out the responses for up to STOP_GRACE and closes everything
+    workersDone = true;
+    wake();
+    io.join();
+
+    close(listenFd);
+    listenFd = -1;
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    wakeFds[0] = wakeFds[1] = -1;
+    unlink(options.socketPath.c_str());
+}
+
+void ParseServer::wake() {
+    // One byte in the pipe is enough until the I/O thread has seen it
+    if (!wakePending.exchange(true)) {
+        char byte = 0;
+        while (write(wakeFds[1], &byte, 1) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+void ParseServer::ioLoop() {
+    vector<shared_ptr<Connection>> connections;
+    vector<pollfd> polled;
+    bool drainSent = false;
+    chrono::steady_clock::time_point deadline;
+
+    while (true) {
+        if (stopping && !drainSent) {
+            // Nothing is read from here on, so the queue only shrinks
+            {
+                lock_guard<mutex> guard(queueLock);
+                drained = true;
+            }
+            queueReady.notify_all();
+            drainSent = true;
+        }
+        bool finishing = workersDone;
+        if (finishing && deadline == chrono::steady_clock::time_point()) {
+            deadline = chrono::steady_clock::now() + STOP_GRACE;
+        }
+        size_t queued;
+        {
+            lock_guard<mutex> guard(queueLock);
+            queued = queue.size();
+        }
+
+        // Drop finished connections, and watch the others for what they can do now
+        polled.clear();
+        polled.push_back({wakeFds[0], POLLIN, 0});
+        polled.push_back({stopping ? -1 : listenFd, POLLIN, 0});
+        bool unsent = false;
+        size_t kept = 0;
+        for (shared_ptr<Connection>& connection : connections) {
+            short events = 0;
+            {
+                lock_guard<mutex> guard(connection->lock);
+                bool done = connection->closed ||
+                            (connection->readClosed && connection->queued == 0 && connection->unsent() == 0) ||
+                            (finishing && connection->unsent() == 0);
+                if (done) {
+                    connection->closed = true;
+                    shutdown(connection->fd, SHUT_RDWR);    // workers may still hold it for a moment
+                    continue;
+                }
+                if (!stopping && !connection->readClosed && connection->unsent() < MAX_UNSENT &&
+                    connection->queued < MAX_CONNECTION_QUEUED && queued < MAX_QUEUED) {
+                    events |= POLLIN;
+                }
+                if (connection->unsent() > 0) {
+                    events |= POLLOUT;
+                    unsent = true;
+                }
+            }
+            polled.push_back({connection->fd, events, 0});
+            connections[kept++] = move(connection);
+        }
+        connections.resize(kept);
+
+        int timeout = -1;
+        if (finishing) {
+            auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+            if (!unsent || left.count() <= 0) {
+                break;
+            }
+            timeout = (int)left.count() + 1;
+        }
+        if (poll(polled.data(), polled.size(), timeout) < 0 && errno != EINTR) {
+            cerr << "\033[31mError: poll: " << strerror(errno) << "\033[0m" << endl;
+            break;
+        }
+
+        if (polled[0].revents) {
+            wakePending = false;    // before draining, so a later wake() writes again
+            char bytes[64];
+            while (read(wakeFds[0], bytes, sizeof(bytes)) > 0) {
+            }
+        }
+        if (polled[1].revents) {
+            int fd;
+            while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+                if (!setNonBlocking(fd)) {
+                    close(fd);
+                    continue;
+                }
+                connections.push_back(make_shared<Connection>(fd));
+                METRIC_COUNT("server_connections", 1);
+            }
+        }
+        for (size_t i = 0; i < kept; i++) {
+            short revents = polled[i + 2].revents;
+            Connection& connection = *connections[i];
+            if (revents & POLLIN) {
+                readFrom(connections[i]);
+            }
+            if (revents & POLLOUT) {
+                lock_guard<mutex> guard(connection.lock);
+                connection.flushLocked();
+            }
+            if ((revents & (POLLERR | POLLNVAL)) || ((revents & POLLHUP) && !(revents & POLLIN))) {
+                lock_guard<mutex> guard(connection.lock);
+                connection.closed = true;   // the peer is gone, nobody to answer
+            }
+        }
+    }
+
+    for (shared_ptr<Connection>& connection : connections) {
+        lock_guard<mutex> guard(connection->lock);
+        connection->closed = true;
+        shutdown(connection->fd, SHUT_RDWR);
+    }
+}
+
+void ParseServer::readFrom(const shared_ptr<Connection>& connection) {
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(connection->fd, chunk, sizeof(chunk))) < 0 && errno == EINTR) {
+    }
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            lock_guard<mutex> guard(connection->lock);
+            connection->closed = true;
+        }
+        return;
+    }
+
+    // Every complete line is a request, all of this read's go into the queue at once
+    vector<Request> requests;
+    string& pending = connection->pending;
+    if (n > 0) {
+        pending.append(chunk, n);
+        size_t start = 0, end;
+        while ((end = pending.find('\n', start)) != string::npos) {
+            size_t length = end - start;
+            if (length > 0 && pending[end - 1] == '\r') length--;
+            if (length > 0) {
+                requests.push_back({connection, pending.substr(start, length)});
+            }
+            start = end + 1;
+        }
+        pending.erase(0, start);
+    } else if (!pending.empty()) {
+        requests.push_back({connection, move(pending)});     // last line without '\n'
+        pending.clear();
+    }
+
+    {
+        // Counted before they are queued, a worker may answer them right away
+        lock_guard<mutex> guard(connection->lock);
+        connection->queued += (int)requests.size();
+        connection->readClosed = n == 0;
+    }
+    if (requests.empty()) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(queueLock);
+        for (Request& request : requests) {
+            queue.push_back(move(request));
+        }
+    }
+    if (requests.size() > 1) {
+        queueReady.notify_all();
+    } else {
+        queueReady.notify_one();
+    }
+}
+
+void ParseServer::workerLoop() {
+    // Per worker parsers, rebuilt when the registry publishes a new version of a grammar
+    struct WorkerGrammar {
+        shared_ptr<const CompiledGrammar> grammar;
+        unique_ptr<Parser> parser;
+    };
+    unordered_map<string, WorkerGrammar> parsers;
+    ParseContext context;
+    vector<Request> batch;
+    vector<pair<Connection*, string>> replies;     // a batch has few distinct connections
+    vector<int> answered;                           // requests per entry of replies
+
+    while (true) {
+        bool wakeReader;
+        {
+            unique_lock<mutex> guard(queueLock);
+            queueReady.wait(guard, [&] { return drained || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            wakeReader = queue.size() >= MAX_QUEUED;     // the I/O thread stopped reading
+            size_t count = min(queue.size(), (size_t)options.maxBatch);
+            for (size_t i = 0; i < count; i++) {
+                batch.push_back(move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        METRIC_COUNT("server_batches", 1);
+        METRIC_COUNT("server_requests", batch.size());
+        METRIC_MAX("server_batch_high_water", batch.size());
+
+        for (const Request& request : batch) {
+            string* reply = nullptr;
+            for (size_t i = 0; i < replies.size() && !reply; i++) {
+                if (replies[i].first == request.connection.get()) {
+                    reply = &replies[i].second;
+                    answered[i]++;
+                }
+            }
+            if (!reply) {
+                replies.push_back({request.connection.get(), string()});
+                answered.push_back(1);
+                reply = &replies.back().second;
+            }
+
+            // <id> <grammar> <input>, the input is everything after the second separator
+            string_view line = request.line;
+            size_t idEnd = line.find_first_of(" \t");
+            string_view id = line.substr(0, idEnd);
+            string_view name, input;
+            if (idEnd != string_view::npos) {
+                size_t nameEnd = line.find_first_of(" \t", idEnd + 1);
+                name = line.substr(idEnd + 1, nameEnd == string_view::npos ? string_view::npos : nameEnd - idEnd - 1);
+                if (nameEnd != string_view::npos) input = line.substr(nameEnd + 1);
+            }
+
+            *reply += "{\"id\":";
+            ResultWriter::appendJsonString(*reply, string(id));
+            auto fail = [&](const string& message) {
+                *reply += ",\"status\":\"error\",\"message\":";
+                ResultWriter::appendJsonString(*reply, message);
+                *reply += "}\n";
+                METRIC_COUNT("server_bad_requests", 1);
+            };
+            if (name.empty()) {
+                fail("expected: <id> <grammar> <input>");
+                continue;
+            }
+
+            string grammarName(name);
+            shared_ptr<const CompiledGrammar> current = registry.get(grammarName);
+            if (!current) {
+                fail("unknown grammar " + grammarName);
+                continue;
+            }
+            WorkerGrammar& cached = parsers[grammarName];
+            if (cached.grammar != current) {
+                cached.grammar = current;
+                cached.parser = make_unique<Parser>(current->makeParser());
+            }
+
+            const ParseResult& result = cached.parser->parseLine(input, context);
+            *reply += ",\"grammar\":";
+            ResultWriter::appendJsonString(*reply, grammarName);
+            *reply += ",";
+            ResultWriter::appendJsonResult(*reply, &current->cfg, result);
+            *reply += "}\n";
+        }
+
+        // Straight to the socket when nothing is waiting ahead of it, whatever doesn't fit
+        // is left to the I/O thread. It is only woken when it has to watch something new
+        for (size_t i = 0; i < replies.size(); i++) {
+            Connection& connection = *replies[i].first;
+            lock_guard<mutex> guard(connection.lock);
+            bool paused = connection.queued >= MAX_CONNECTION_QUEUED;
+            connection.queued -= answered[i];
+            if (!connection.closed) {
+                bool idle = connection.unsent() == 0;
+                connection.outbox += replies[i].second;
+                if (idle) {
+                    connection.flushLocked();
+                    wakeReader |= connection.unsent() > 0 || connection.closed;
+                }
+                METRIC_MAX("server_unsent_high_water", connection.unsent());
+            }
+            wakeReader |= paused || (connection.readClosed && connection.queued == 0);
+        }
+        if (wakeReader) {
+            wake();
+        }
+        replies.clear();
+        answered.clear();
+        batch.clear();      // drops the batch's connection references
+    }
+}
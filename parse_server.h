@@ -0,0 +1,104 @@
+#ifndef PARSE_SERVER_H
+#define PARSE_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "grammar_registry.h"
+#include "work_pool.h"
+
+using namespace std;
+
+struct ServerOptions {
+    string socketPath = "/tmp/cfg_parser.sock";
+    int threads = WorkPool::defaultThreads();
+    int maxBatch = 64;      // requests a worker takes off the queue at once
+};
+
+// Long running validation service on a Unix domain socket (POSIX only). The grammars
+// come from a GrammarRegistry, analysed once up front and shared by all workers.
+//
+// Protocol, one request per line (pipelining is fine, responses carry the id and may
+// come back out of order across a batch boundary):
+//     <id> <grammar> <input line>\n
+//     {"id":"<id>","grammar":"<grammar>","status":"accepted","tokens":6,"errors":[]}\n
+// A bad request gets {"id":...,"status":"error","message":...}.
+//
+// One I/O thread runs a poll() loop over the listening socket and every connection,
+// all non-blocking: it queues all the complete lines of a read() under one lock and
+// writes out whatever the connections' outboxes hold. Workers take up to maxBatch
+// queued requests per wake up, parse them with their own Parser / ParseContext per
+// grammar and append the batch's responses to each connection's outbox, writing
+// directly when it was empty, so under load the queue lock and the syscalls are paid
+// per batch, not per request; a lone request still goes out right away. Nobody ever
+// blocks on a peer: a client that doesn't read its responses only fills its own
+// outbox, and once that (or its number of queued requests) passes a cap the server
+// stops reading from it until it catches up, so it can't starve the other clients.
+class ParseServer {
+private:
+    struct Connection {
+        int fd;
+        string pending;             // partial request line (I/O thread only)
+
+        mutex lock;                 // the rest is shared with the workers
+        string outbox;              // responses the socket didn't take yet, from sent on
+        size_t sent = 0;
+        int queued = 0;             // requests in the queue or being parsed
+        bool readClosed = false;    // the peer is done sending
+        bool closed = false;        // gone or failed, responses are dropped
+
+        explicit Connection(int socket) : fd(socket) {}
+        ~Connection();
+        size_t unsent() const { return outbox.size() - sent; }
+        void flushLocked();         // writes what the socket takes without blocking
+    };
+
+    struct Request {
+        shared_ptr<Connection> connection;
+        string line;        // the whole request line, split by the worker
+    };
+
+    GrammarRegistry& registry;
+    ServerOptions options;
+    int listenFd = -1;
+    int wakeFds[2] = {-1, -1};      // pipe that interrupts the I/O thread's poll()
+    atomic<bool> wakePending{false};
+    atomic<bool> stopping{false};
+    atomic<bool> workersDone{false};
+
+    mutex queueLock;
+    condition_variable queueReady;  // requests queued (or drained)
+    deque<Request> queue;
+    bool drained = false;           // no more requests are coming, workers exit when empty
+
+    thread io;
+    vector<thread> workers;
+
+    void wake();
+    void ioLoop();
+    void readFrom(const shared_ptr<Connection>& connection);
+    void workerLoop();
+
+public:
+    ParseServer(GrammarRegistry& grammars, ServerOptions serverOptions);
+    ~ParseServer() { stop(); }
+
+    ParseServer(const ParseServer&) = delete;
+    ParseServer& operator=(const ParseServer&) = delete;
+
+    // Binds the socket (replacing a stale socket file) and starts the threads. False
+    // with a message on stderr if the socket can't be set up
+    bool start();
+
+    // Stops accepting and reading, answers what is already queued, gives the clients a
+    // moment to read their responses (a client that doesn't is simply cut off), closes
+    // every connection and removes the socket file. Safe to call more than once
+    void stop();
+};
+
+#endif // PARSE_SERVER_H
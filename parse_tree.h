@@ -0,0 +1,113 @@
+#ifndef PARSE_TREE_H
+#define PARSE_TREE_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "symbols.h"
+
+using namespace std;
+
+struct ParseNode {
+    SymbolId symbol;
+    int firstChild;   // children are the contiguous nodes [firstChild, firstChild + childCount), -1 = not expanded
+    int childCount;
+    int token;        // index of the matched input token for terminals, -1 otherwise
+};
+
+// Bump allocator for parse nodes. Nodes are handed out in runs from big fixed size
+// blocks and addressed by index; reset() just rewinds, so after the first few lines a
+// tree costs no allocation at all. A run never straddles two blocks (unless it is
+// bigger than a block), so a node's children also sit next to each other in memory.
+class NodeArena {
+private:
+    static const int BLOCK_BITS = 12;
+    static const int BLOCK_SIZE = 1 << BLOCK_BITS;
+
+    vector<unique_ptr<ParseNode[]>> blocks;
+    int used = 0;
+
+public:
+    // Index of the first of count fresh nodes
+    int allocate(int count) {
+        int offset = used & (BLOCK_SIZE - 1);
+        if (offset != 0 && offset + count > BLOCK_SIZE && count <= BLOCK_SIZE) {
+            used += BLOCK_SIZE - offset;    // skip the tail of the current block
+        }
+        int first = used;
+        used += count;
+        while ((int)blocks.size() * BLOCK_SIZE < used) {
+            blocks.emplace_back(new ParseNode[BLOCK_SIZE]);
+        }
+        return first;
+    }
+
+    ParseNode& operator[](int index) {
+        return blocks[index >> BLOCK_BITS][index & (BLOCK_SIZE - 1)];
+    }
+
+    const ParseNode& operator[](int index) const {
+        return blocks[index >> BLOCK_BITS][index & (BLOCK_SIZE - 1)];
+    }
+
+    void reset() { used = 0; }
+    int size() const { return used; }
+    int blockCount() const { return blocks.size(); }
+};
+
+// Concrete syntax trees of one or more parsed lines (one root per line). Filled in by
+// Parser::parseLine while it expands productions when a tree is attached to it.
+class ParseTree {
+private:
+    NodeArena nodes;
+    vector<int> roots;
+
+public:
+    void reset() {
+        nodes.reset();
+        roots.clear();
+    }
+
+    int newRoot(SymbolId symbol) {
+        int index = nodes.allocate(1);
+        nodes[index] = {symbol, -1, 0, -1};
+        roots.push_back(index);
+        return index;
+    }
+
+    // Gives node its children (the production's rhs), returns the index of the first
+    int expand(int node, SymbolSpan rhs) {
+        int first = nodes.allocate(rhs.size());     // an ε expansion still gets a (zero length) position
+        for (int i = 0; i < rhs.size(); i++) {
+            nodes[first + i] = {rhs[i], -1, 0, -1};
+        }
+        nodes[node].firstChild = first;
+        nodes[node].childCount = rhs.size();
+        return first;
+    }
+
+    void setToken(int node, int token) { nodes[node].token = token; }
+
+    const ParseNode& node(int index) const { return nodes[index]; }
+    const vector<int>& getRoots() const { return roots; }
+    int nodeCount() const { return nodes.size(); }
+
+    // Indented dump, ε for empty expansions and the token text for matched terminals
+    void print(int index, const SymbolTable& symbols, const vector<string_view>& tokens, int depth = 0) const {
+        const ParseNode& n = nodes[index];
+        cout << string(depth * 2, ' ') << symbols.name(n.symbol);
+        if (n.token >= 0 && n.token < (int)tokens.size()) {
+            cout << "  '" << tokens[n.token] << "'";
+        }
+        cout << "\n";
+        if (n.firstChild >= 0 && n.childCount == 0) {
+            cout << string(depth * 2 + 2, ' ') << "ε\n";
+        }
+        for (int i = 0; i < n.childCount; i++) {
+            print(n.firstChild + i, symbols, tokens, depth + 1);
+        }
+    }
+};
+
+#endif // PARSE_TREE_H
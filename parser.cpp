@@ -1,28 +1,76 @@
-#include "Parser.h"
+#include "parser.h"
 
-Parser::Parser(CFG* grammar) {
+void printLineResult(const CFG* cfg, int lineNum, const ParseResult& result, ostream& out) {
+    if (result.accepted) {
+        out << "\033[32mLine " << lineNum << ": Parsing successful!\033[0m\n";
+        return;
+    }
+
+    const ParseError& last = result.errors.back();
+    if (last.kind == ParseErrorKind::UnexpectedEnd) {
+        out << "\033[31mLine " << lineNum << ": Parsing failed. ";
+        out << "Unexpected end of input. Expected: " << cfg->getSymbols().name(last.expected) << "\033[0m\n";
+    } else if (last.kind == ParseErrorKind::ExtraInput) {
+        out << "\033[31mLine " << lineNum << ": Parsing failed. ";
+        out << "Extra input after parsing completed.\033[0m\n";
+    } else {
+        out << "\033[31mLine " << lineNum << ": Parsing failed with " << result.errorCount << " error(s).\033[0m\n";
+    }
+}
+
+Parser::Parser(const CFG* grammar) {
     cfg = grammar;
     // Assuming the first non-terminal in the grammar is the start symbol
-    startSymbol = cfg->getStartSymbol();
+    startSymbol = cfg->getStartSymbolId();
     errorCount = 0;
 }
 
-void Parser::parseFile(const string& filename) {
-    ifstream file(filename);
-    if (!file.is_open()) {
+Parser::Parser(shared_ptr<const CFG> grammar) : Parser(grammar.get()) {
+    owner = move(grammar);
+}
+
+void Parser::parseFile(const string& filename, bool trace, int threads) {
+    // The whole file is mapped once, every line and token is a view into it
+    MappedFile file;
+    if (!file.open(filename)) {
         cout << "\033[31mError: Unable to open input file!\033[0m" << endl;
         return;
     }
 
-    string line;
-    int lineNum = 1;
-
     cout << "\n\033[1;36m========== PARSING INPUT STRINGS ==========\033[0m\n";
-    
-    while (getline(file, line)) {
-        cout << "\n\033[1;33mParsing Line " << lineNum << ": \"" << line << "\"\033[0m\n";
-        parseString(line, lineNum);
-        lineNum++;
+
+    if (trace || threads <= 1) {
+        forEachLine(file.view(), [&](string_view line, int lineNum) {
+            if (trace) {
+                cout << "\n\033[1;33mParsing Line " << lineNum << ": \"" << line << "\"\033[0m\n";
+                parseString(line, lineNum);
+            } else {
+                printLineResult(cfg, lineNum, parseLine(line, lineNum));
+            }
+        });
+    } else {
+        // Fixed size batches, so the views and results held at once don't grow with the file
+        const size_t batchSize = 1 << 16;
+        vector<string_view> lines;
+        vector<ParseResult> results;
+        int firstLineNum = 1;
+        auto flushBatch = [&]() {
+            parseLines(lines, firstLineNum, threads, results);
+            for (size_t i = 0; i < results.size(); i++) {
+                printLineResult(cfg, firstLineNum + i, results[i]);
+            }
+            firstLineNum += lines.size();
+            lines.clear();
+        };
+        forEachLine(file.view(), [&](string_view line, int) {
+            lines.push_back(line);
+            if (lines.size() == batchSize) {
+                flushBatch();
+            }
+        });
+        if (!lines.empty()) {
+            flushBatch();
+        }
     }
 
     cout << "\n\033[1;36m========== PARSING SUMMARY ==========\033[0m\n";
@@ -31,95 +79,125 @@ void Parser::parseFile(const string& filename) {
     } else {
         cout << "\033[1;31mParsing completed with " << errorCount << " error(s).\033[0m\n";
     }
-
-    file.close();
 }
 
-// First, make sure your Parser.h has the appropriate function declaration:
-// In Parser.h, you should have something like:
-// string getStackContents(stack<string> stk);
-
-// Then implement the function in Parser.cpp:
-string Parser::getStackContents(stack<string> stk) {
-    string result = "";
-    vector<string> items;
-    
-    // Extract items from stack
-    while (!stk.empty()) {
-        items.push_back(stk.top());
-        stk.pop();
+void Parser::parseLines(const vector<string_view>& lines, int firstLineNum, int threads, vector<ParseResult>& results) {
+    results.resize(lines.size());
+    if (threads <= 1 || lines.size() < 2) {
+        for (size_t i = 0; i < lines.size(); i++) {
+            results[i] = parseLine(lines[i], scratch, firstLineNum + i);     // copy reuses results[i]'s buffer
+        }
+        return;
     }
-    
-    // Reconstruct the stack content string (in correct order from bottom to top)
-    for (int i = items.size() - 1; i >= 0; i--) {
-        result += items[i];
-        if (i > 0) result += " ";
+
+    // Lines are independent: shard them in chunks over the pool, every worker gets its
+    // own Parser (stack, scratch buffers, error count) and the CFG is only read
+    const int chunkSize = 256;
+    int chunks = (lines.size() + chunkSize - 1) / chunkSize;
+    Parser prototype(cfg);
+    prototype.owner = owner;
+    prototype.lexer = lexer;    // no observer or tree, those aren't thread safe
+    vector<Parser> workers(min(threads, chunks), prototype);
+
+    WorkPool::run(chunks, workers.size(), [&](int worker, int chunk) {
+        int end = min<int>(lines.size(), (chunk + 1) * chunkSize);
+        for (int i = chunk * chunkSize; i < end; i++) {
+            results[i] = workers[worker].parseLine(lines[i], workers[worker].scratch, firstLineNum + i);
+        }
+    });
+
+    for (const Parser& worker : workers) {
+        errorCount += worker.errorCount;
     }
-    
-    return result;
 }
 
-// And here's the fixed parseString method:
-void Parser::parseString(const string& input, int lineNum) {
-    istringstream iss(input);
-    vector<string> tokens;
-    string token;
+void Parser::parseString(string_view input, int lineNum) {
+    TracePrinter printer(cfg);
+    ParseObserver* previous = observer;
+    observer = &printer;
+    parseLine(input, lineNum);
+    observer = previous;
+}
 
-    // Tokenize input string
-    while (iss >> token) {
-        tokens.push_back(token);
+ParseResult Parser::parseLine(string_view input, int lineNum) {
+    return parseLine(input, scratch, lineNum);
+}
+
+const ParseResult& Parser::parseLine(string_view input, ParseContext& context, int lineNum) {
+    METRIC_TIMER("parser_line");
+    const SymbolTable& symbols = cfg->getSymbols();
+    context.clear();
+    ParseResult& result = context.result;
+    vector<string_view>& tokenText = context.tokenText;
+    vector<SymbolId>& tokens = context.tokens;
+    vector<SymbolId>& parsingStack = context.parsingStack;
+    vector<int>& nodeStack = context.nodeStack;
+
+    // Tokenize input string, tokens are slices of the input.
+    // Unknown tokens become NO_SYMBOL and never match anything
+    vector<Token>& lexTokens = context.lexTokens;
+    if (lexer) {
+        lexer->scan(input, lexTokens);
+        for (const Token& token : lexTokens) {
+            tokenText.push_back(input.substr(token.offset, token.length));
+            tokens.push_back(token.id);
+        }
+    } else {
+        TokenScanner::scan(input, lexTokens);
+        for (const Token& token : lexTokens) {
+            tokenText.push_back(input.substr(token.offset, token.length));
+            tokens.push_back(symbols.lookupTerminal(tokenText.back()));
+        }
     }
-    tokens.push_back("$"); // Add end marker
+    result.tokenCount = tokens.size();
+    tokens.push_back(END_MARKER); // Add end marker
+    tokenText.push_back("$");
+
+    auto offsetOf = [&](int index) {
+        return index < result.tokenCount ? int(tokenText[index].data() - input.data()) : int(input.size());
+    };
 
-    // Initialize stack with end marker and start symbol
-    stack<string> parsingStack;
-    parsingStack.push("$");
-    parsingStack.push(startSymbol);
+    // Initialize stack with end marker and start symbol (top is the back of the vector)
+    parsingStack.push_back(END_MARKER);
+    parsingStack.push_back(startSymbol);
+    if (tree) {
+        if (resetTreePerLine) tree->reset();
+        nodeStack.push_back(-1);
+        nodeStack.push_back(tree->newRoot(startSymbol));
+    }
 
     int inputPos = 0;
     bool inErrorRecoveryMode = false;
-    int lineErrors = 0;
-    
-    // Print table header for parsing steps
-    cout << "\n\033[1;34m+-------------------------------+----------------------+------------------------+\033[0m";
-    cout << "\n\033[1;34m| Stack                         | Current Input        | Action                 |\033[0m";
-    cout << "\n\033[1;34m+-------------------------------+----------------------+------------------------+\033[0m";
 
-    // Parsing algorithm
-    while (!parsingStack.empty() && inputPos < tokens.size()) {
-        string currentInput = tokens[inputPos];
-        
-        // Print current stack contents
-        string stackContent = getStackContents(parsingStack);
-        
-        // Format and print current state
-        cout << "\n\033[0m| " << left << setw(30) << stackContent;
-
-        // Display remaining input
-        string remainingInput = "";
-        for (int i = inputPos; i < tokens.size(); i++) {
-            remainingInput += tokens[i];
-            if (i < tokens.size() - 1) remainingInput += " ";
+    // Only the first error of a cascade is counted, the rest are recovery steps
+    auto recordError = [&](ParseErrorKind kind, SymbolId expected) {
+        if (!inErrorRecoveryMode) {
+            result.errors.push_back({kind, inputPos, offsetOf(inputPos), expected, tokens[inputPos]});
+            inErrorRecoveryMode = true;
         }
-        cout << "| " << left << setw(20) << remainingInput;
-        
-        string top = parsingStack.top();
-        parsingStack.pop();
-        
+    };
+
+    if (observer) observer->beginLine(lineNum, tokenText);
+
+    // Parsing algorithm
+    while (!parsingStack.empty() && inputPos < (int)tokens.size()) {
+        SymbolId currentInput = tokens[inputPos];
+        SymbolId top = parsingStack.back();
+        result.steps++;
+
         // Case 1: Top is end marker
-        if (top == "$") {
-            if (currentInput == "$") {
-                cout << "| Accept                 |";
+        if (top == END_MARKER) {
+            if (currentInput == END_MARKER) {
+                if (observer) observer->step(parsingStack, inputPos, ParseAction::Accept, -1);
                 inputPos++; // Increment to show we've consumed the final $ token
                 // We're emptying the stack here, which means successful parsing
-                parsingStack = stack<string>(); // Clear the stack
+                parsingStack.clear();
                 break;
             } else {
-                cout << "| \033[31mError: Expected end of input\033[0m |";
-                if (!inErrorRecoveryMode) {
-                    lineErrors++;
-                    inErrorRecoveryMode = true;
-                }
+                if (observer) observer->step(parsingStack, inputPos, ParseAction::ErrorExpectedEnd, -1);
+                recordError(ParseErrorKind::ExpectedEnd, top);
+                parsingStack.pop_back();
+                if (tree) nodeStack.pop_back();
                 inputPos++;
             }
         }
@@ -127,73 +205,151 @@ void Parser::parseString(const string& input, int lineNum) {
         // Case 2: Top is a terminal
         else if (cfg->isTerminal(top)) {
             if (top == currentInput) {
-                cout << "| Match and advance       |";
+                if (observer) observer->step(parsingStack, inputPos, ParseAction::Match, -1);
+                parsingStack.pop_back();
+                if (tree) {
+                    tree->setToken(nodeStack.back(), inputPos);
+                    nodeStack.pop_back();
+                }
                 inputPos++;
                 inErrorRecoveryMode = false; // Reset error recovery mode after successful match
             } else {
-                cout << "| \033[31mError: Expected '" << top << "'\033[0m |";
-                // Error recovery: Skip current input token
-                if (!inErrorRecoveryMode) {
-                    lineErrors++;
-                    inErrorRecoveryMode = true;
-                }
-                parsingStack.push(top); // Put back the token
-                inputPos++; // Skip the problematic input token
+                if (observer) observer->step(parsingStack, inputPos, ParseAction::ErrorMismatch, -1);
+                // Panic mode: act as if the expected terminal had been there and pop it
+                recordError(ParseErrorKind::Mismatch, top);
+                parsingStack.pop_back();
+                if (tree) nodeStack.pop_back();
             }
         }
-        
+
         // Case 3: Top is a non-terminal
         else {
-            vector<string> production = cfg->getParsingTableEntry(top, currentInput);
-            
-            if (production.empty()) {
-                cout << "| \033[31mError: No production for (" << top << ", " << currentInput << ")\033[0m |";
-                // Error recovery: Skip the problematic non-terminal
-                if (!inErrorRecoveryMode) {
-                    lineErrors++;
-                    inErrorRecoveryMode = true;
-                }
-                inputPos++; // Skip input token
+            int prodIndex = cfg->getParsingTableEntry(top, currentInput);
+
+            if (prodIndex == TABLE_SYNCH || (prodIndex == TABLE_ERROR && currentInput == END_MARKER)) {
+                if (observer) observer->step(parsingStack, inputPos, ParseAction::ErrorSynch, -1);
+                // Panic mode: the input can follow this non-terminal, give up on it and pop it
+                recordError(ParseErrorKind::NoEntry, top);
+                parsingStack.pop_back();
+                if (tree) nodeStack.pop_back();
+            } else if (prodIndex == TABLE_ERROR) {
+                if (observer) observer->step(parsingStack, inputPos, ParseAction::ErrorNoEntry, -1);
+                // Panic mode: skip input until a token this non-terminal can start with or sync on
+                recordError(ParseErrorKind::NoEntry, top);
+                inputPos++;
             } else {
-                // Format production for display
-                string productionStr = top + " -> ";
-                for (const auto& symbol : production) {
-                    productionStr += symbol + " ";
+                if (observer) observer->step(parsingStack, inputPos, ParseAction::Apply, prodIndex);
+                parsingStack.pop_back();
+
+                // Push production in reverse order (ε productions are empty, nothing gets pushed)
+                SymbolSpan production = cfg->getProductionRhs(prodIndex);
+                for (int i = production.size() - 1; i >= 0; i--) {
+                    parsingStack.push_back(production[i]);
                 }
-                cout << "| Apply: " << left << setw(14) << productionStr << "|";
-                
-                // Push production in reverse order
-                if (production.size() == 1 && production[0] == "ε") {
-                    // If production is epsilon, don't push anything
-                } else {
+                result.maxStackDepth = max(result.maxStackDepth, (int)parsingStack.size());
+
+                // The children are allocated as one run, pushed in the same reverse order
+                if (tree) {
+                    int first = tree->expand(nodeStack.back(), production);
+                    nodeStack.pop_back();
                     for (int i = production.size() - 1; i >= 0; i--) {
-                        parsingStack.push(production[i]);
+                        nodeStack.push_back(first + i);
                     }
                 }
                 inErrorRecoveryMode = false; // Reset error recovery mode after successful production application
             }
         }
     }
-    
-    cout << "\n\033[1;34m+-------------------------------+----------------------+------------------------+\033[0m\n";
-    
+
     // Final result for this line
-    if (lineErrors > 0) {
-        cout << "\033[31mLine " << lineNum << ": Parsing failed with " << lineErrors << " error(s).\033[0m\n";
-        errorCount += lineErrors;
-    } else if (parsingStack.empty() && inputPos >= tokens.size() - 1) {  // Successfully processed all input
-        cout << "\033[32mLine " << lineNum << ": Parsing successful!\033[0m\n";
-    } else {
-        lineErrors++;
-        errorCount++;
-        cout << "\033[31mLine " << lineNum << ": Parsing failed. ";
-        
-        if (!parsingStack.empty()) {
-            cout << "Unexpected end of input. Expected: " << parsingStack.top() << "\033[0m\n";
-        } else if (inputPos < tokens.size() - 1) {
-            cout << "Extra input after parsing completed.\033[0m\n";
+    if (result.errors.empty()) {
+        if (parsingStack.empty() && inputPos >= (int)tokens.size() - 1) {  // Successfully processed all input
+            result.accepted = true;
+        } else if (!parsingStack.empty()) {
+            result.errors.push_back({ParseErrorKind::UnexpectedEnd, inputPos, offsetOf(inputPos),
+                                     parsingStack.back(), NO_SYMBOL});
         } else {
-            cout << "Unknown error.\033[0m\n";
+            result.errors.push_back({ParseErrorKind::ExtraInput, inputPos, offsetOf(inputPos), NO_SYMBOL, tokens[inputPos]});
         }
     }
-}
\ No newline at end of file
+    result.errorCount = result.errors.size();
+    errorCount += result.errorCount;
+
+    METRIC_COUNT("parser_lines", 1);
+    METRIC_COUNT("parser_tokens", result.tokenCount);
+    METRIC_COUNT("parser_steps", result.steps);
+    METRIC_COUNT("parser_errors", result.errorCount);
+    METRIC_COUNT("parser_rejected_lines", result.accepted ? 0 : 1);
+    METRIC_MAX("parser_stack_high_water", result.maxStackDepth);
+
+    if (observer) observer->endLine(lineNum, result, parsingStack);
+    return result;
+}
+
+string TracePrinter::getStackContents(const vector<SymbolId>& stk) const {
+    const SymbolTable& symbols = cfg->getSymbols();
+    string result = "";
+
+    // Stack content string in order from bottom to top
+    for (size_t i = 0; i < stk.size(); i++) {
+        result += symbols.name(stk[i]);
+        if (i + 1 < stk.size()) result += " ";
+    }
+
+    return result;
+}
+
+void TracePrinter::beginLine(int /*lineNum*/, const vector<string_view>& lineTokens) {
+    tokens = &lineTokens;
+
+    // Print table header for parsing steps
+    cout << "\n\033[1;34m+-------------------------------+----------------------+------------------------+\033[0m";
+    cout << "\n\033[1;34m| Stack                         | Current Input        | Action                 |\033[0m";
+    cout << "\n\033[1;34m+-------------------------------+----------------------+------------------------+\033[0m";
+}
+
+void TracePrinter::step(const vector<SymbolId>& stack, int inputPos, ParseAction action, int prodIndex) {
+    const SymbolTable& symbols = cfg->getSymbols();
+
+    // Format and print current state
+    cout << "\n\033[0m| " << left << setw(30) << getStackContents(stack);
+
+    // Display remaining input
+    string remainingInput = "";
+    for (size_t i = inputPos; i < tokens->size(); i++) {
+        remainingInput += (*tokens)[i];
+        if (i < tokens->size() - 1) remainingInput += " ";
+    }
+    cout << "| " << left << setw(20) << remainingInput;
+
+    SymbolId top = stack.back();
+    switch (action) {
+        case ParseAction::Accept:
+            cout << "| Accept                 |";
+            break;
+        case ParseAction::ErrorExpectedEnd:
+            cout << "| \033[31mError: Expected end of input\033[0m |";
+            break;
+        case ParseAction::Match:
+            cout << "| Match and advance       |";
+            break;
+        case ParseAction::ErrorMismatch:
+            cout << "| \033[31mError: Expected '" << symbols.name(top) << "', inserted\033[0m |";
+            break;
+        case ParseAction::ErrorNoEntry:
+            cout << "| \033[31mError: No production for (" << symbols.name(top) << ", " << (*tokens)[inputPos] << "), skip input\033[0m |";
+            break;
+        case ParseAction::ErrorSynch:
+            cout << "| \033[31mError: No production for (" << symbols.name(top) << ", " << (*tokens)[inputPos] << "), pop " << symbols.name(top) << "\033[0m |";
+            break;
+        case ParseAction::Apply:
+            cout << "| Apply: " << left << setw(14) << cfg->productionToString(prodIndex) << "|";
+            break;
+    }
+}
+
+void TracePrinter::endLine(int lineNum, const ParseResult& result, const vector<SymbolId>& /*stack*/) {
+    cout << "\n\033[1;34m+-------------------------------+----------------------+------------------------+\033[0m\n";
+    printLineResult(cfg, lineNum, result);
+    tokens = nullptr;
+}
@@ -2,26 +2,180 @@
 #define PARSER_H
 
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <sstream>
-#include <stack>
+#include <vector>
 #include "CFG.h"
+#include "mapped_file.h"
+#include "work_pool.h"
+#include "lexer.h"
+#include "token_scanner.h"
+#include "parse_tree.h"
 
 using namespace std;
 
+enum class ParseErrorKind {
+    ExpectedEnd,     // stack is down to $ but input is left
+    Mismatch,        // terminal on the stack doesn't match the input
+    NoEntry,         // no production for (non-terminal, input), blank or synch cell
+    UnexpectedEnd,   // input ran out while the stack still had symbols
+    ExtraInput       // stack emptied before all input was consumed
+};
+
+struct ParseError {
+    ParseErrorKind kind;
+    int tokenIndex;      // index of the offending token in the line ($ = token count)
+    int offset;          // byte offset of that token in the line
+    SymbolId expected;   // stack top at the time of the error (NO_SYMBOL if none)
+    SymbolId found;      // input token id (NO_SYMBOL for unknown tokens)
+};
+
+// Outcome of parsing one line, filled in without any formatting or I/O
+struct ParseResult {
+    bool accepted = false;
+    int errorCount = 0;   // one per error cascade, same counting as the trace output
+    int steps = 0;
+    int tokenCount = 0;   // not counting the $ end marker
+    int maxStackDepth = 0;
+    vector<ParseError> errors;
+
+    // Back to the empty state, keeps the errors' capacity
+    void reset() {
+        accepted = false;
+        errorCount = steps = tokenCount = maxStackDepth = 0;
+        errors.clear();
+    }
+};
+
+// Everything a parse needs per line besides the grammar: token buffers, the symbol
+// stack and the diagnostics. Clearing keeps the capacity, so once a context has seen
+// its longest line, parsing into it doesn't allocate. One context per thread; keep it
+// for as long as the session runs (across lines and files).
+struct ParseContext {
+    vector<Token> lexTokens;        // from the lexer or the whitespace scanner
+    vector<string_view> tokenText;  // views into the current line, $ included
+    vector<SymbolId> tokens;
+    vector<SymbolId> parsingStack;
+    vector<int> nodeStack;          // tree node of every stack entry, only used with a tree
+    ParseResult result;             // diagnostics of the last line
+
+    explicit ParseContext(size_t tokenCapacity = 256, size_t stackCapacity = 256) {
+        reserve(tokenCapacity, stackCapacity);
+    }
+
+    void reserve(size_t tokenCapacity, size_t stackCapacity) {
+        lexTokens.reserve(tokenCapacity);
+        tokenText.reserve(tokenCapacity + 1);
+        tokens.reserve(tokenCapacity + 1);
+        parsingStack.reserve(stackCapacity);
+        result.errors.reserve(16);
+    }
+
+    void clear() {
+        lexTokens.clear();
+        tokenText.clear();
+        tokens.clear();
+        parsingStack.clear();
+        nodeStack.clear();
+        result.reset();
+    }
+};
+
+enum class ParseAction {
+    Apply,
+    Match,
+    Accept,
+    ErrorExpectedEnd,
+    ErrorMismatch,      // expected terminal popped as if it had been there
+    ErrorNoEntry,       // blank table cell, input token skipped
+    ErrorSynch          // synch cell (input in FOLLOW), non-terminal popped
+};
+
+// Optional hook into the parse loop (e.g. the step by step trace table). The parser
+// only calls it when one is attached, so plain validation pays nothing for it.
+class ParseObserver {
+public:
+    virtual ~ParseObserver() {}
+    virtual void beginLine(int /*lineNum*/, const vector<string_view>& /*tokens*/) {}
+    // Called once per step before the stack is changed. prodIndex is only set for Apply
+    virtual void step(const vector<SymbolId>& /*stack*/, int /*inputPos*/, ParseAction /*action*/, int /*prodIndex*/) {}
+    virtual void endLine(int /*lineNum*/, const ParseResult& /*result*/, const vector<SymbolId>& /*stack*/) {}
+};
+
+// The coloured stack / input / action table the parser has always printed
+class TracePrinter : public ParseObserver {
+private:
+    const CFG* cfg;
+    const vector<string_view>* tokens = nullptr;
+
+    string getStackContents(const vector<SymbolId>& stk) const;
+
+public:
+    TracePrinter(const CFG* grammar) : cfg(grammar) {}
+    void beginLine(int lineNum, const vector<string_view>& lineTokens) override;
+    void step(const vector<SymbolId>& stack, int inputPos, ParseAction action, int prodIndex) override;
+    void endLine(int lineNum, const ParseResult& result, const vector<SymbolId>& stack) override;
+};
+
+// Coloured one line verdict, shared by the trace and the plain validation output
+void printLineResult(const CFG* cfg, int lineNum, const ParseResult& result, ostream& out = cout);
+
 class Parser {
 private:
-    CFG* cfg;
-    string startSymbol;
+    const CFG* cfg;                 // only ever read, can be shared by any number of parsers
+    shared_ptr<const CFG> owner;    // keeps a shared grammar alive, empty for a plain pointer
+    SymbolId startSymbol;
     int errorCount;
+    ParseObserver* observer = nullptr;
+    const Lexer* lexer = nullptr;   // nullptr = split tokens on whitespace
+    ParseTree* tree = nullptr;      // nullptr = validate only, no tree
+    bool resetTreePerLine = true;
 
-    string getStackContents(stack<string> stk);
+    ParseContext scratch;           // for the parseLine overload without a context
 
 public:
-    Parser(CFG* grammar);
-    void parseFile(const string& filename);
-    void parseString(const string& input, int lineNum);
+    Parser(const CFG* grammar);
+
+    // Shares ownership of an immutable grammar (e.g. from GrammarRegistry), it stays
+    // alive for as long as this parser or a copy of it does, even if it gets replaced
+    Parser(shared_ptr<const CFG> grammar);
+
+    // Attach an observer for every following parseLine call (nullptr detaches)
+    void setObserver(ParseObserver* obs) { observer = obs; }
+
+    // Tokenize with the grammar's DFA lexer instead of whitespace splitting (nullptr resets)
+    void setLexer(const Lexer* lex) { lexer = lex; }
+
+    // Build a parse tree while parsing (nullptr turns it off). With resetPerLine the
+    // arena is rewound for every line, otherwise each line adds one more root until the
+    // caller resets the tree (e.g. once per batch)
+    void setTree(ParseTree* parseTree, bool resetPerLine = true) {
+        tree = parseTree;
+        resetTreePerLine = resetPerLine;
+    }
+
+    // threads > 1 validates lines in parallel (trace output is always sequential),
+    // verdicts are still printed in line order
+    void parseFile(const string& filename, bool trace = true, int threads = 1);
+
+    // Validates a batch of lines, results[i] for lines[i] (numbered firstLineNum + i).
+    // With threads > 1 the lines are sharded over a pool of copies of this parser, which
+    // keep only the lexer (no observer, no tree); the error count is added up here
+    void parseLines(const vector<string_view>& lines, int firstLineNum, int threads, vector<ParseResult>& results);
+    void parseString(string_view input, int lineNum);   // always prints the trace
+    ParseResult parseLine(string_view input, int lineNum = 0);
+
+    // Allocation free form: everything goes into context, the result lives there too
+    // (valid until the context's next line)
+    const ParseResult& parseLine(string_view input, ParseContext& context, int lineNum = 0);
+    int getErrorCount() const { return errorCount; }
+
+    // Tokens of the last parsed line (views into that line, $ included), e.g. for
+    // printing the terminals of a parse tree
+    const vector<string_view>& getTokens() const { return scratch.tokenText; }
 };
 
-#endif // PARSER_H
\ No newline at end of file
+#endif // PARSER_H
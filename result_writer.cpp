@@ -0,0 +1,134 @@
+#include "result_writer.h"
+
+ResultWriter::ResultWriter(const CFG* grammar, ResultFormat outputFormat, ostream& output)
+    : cfg(grammar), format(outputFormat), out(output) {}
+
+bool ResultWriter::parseFormat(const string& name, ResultFormat& format) {
+    if (name == "text") {
+        format = ResultFormat::Text;
+    } else if (name == "jsonl" || name == "json") {
+        format = ResultFormat::Jsonl;
+    } else if (name == "csv") {
+        format = ResultFormat::Csv;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* ResultWriter::errorKindName(ParseErrorKind kind) {
+    switch (kind) {
+        case ParseErrorKind::ExpectedEnd: return "expected_end";
+        case ParseErrorKind::Mismatch: return "mismatch";
+        case ParseErrorKind::NoEntry: return "no_entry";
+        case ParseErrorKind::UnexpectedEnd: return "unexpected_end";
+        case ParseErrorKind::ExtraInput: return "extra_input";
+    }
+    return "unknown";
+}
+
+void ResultWriter::appendJsonString(string& text, const string& value) {
+    text += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': text += "\\\""; break;
+            case '\\': text += "\\\\"; break;
+            case '\n': text += "\\n"; break;
+            case '\r': text += "\\r"; break;
+            case '\t': text += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    text += escaped;
+                } else {
+                    text += c;
+                }
+        }
+    }
+    text += '"';
+}
+
+void ResultWriter::appendCsvField(string& text, const string& value) {
+    if (value.find_first_of(",\"\n\r") == string::npos) {
+        text += value;
+        return;
+    }
+    text += '"';
+    for (char c : value) {
+        if (c == '"') text += '"';
+        text += c;
+    }
+    text += '"';
+}
+
+void ResultWriter::appendJsonResult(string& text, const CFG* cfg, const ParseResult& result) {
+    const SymbolTable& symbols = cfg->getSymbols();
+    text += result.accepted ? "\"status\":\"accepted\"" : "\"status\":\"rejected\"";
+    text += ",\"tokens\":" + to_string(result.tokenCount);
+    text += ",\"errors\":[";
+    for (size_t i = 0; i < result.errors.size(); i++) {
+        const ParseError& error = result.errors[i];
+        text += i ? ",{\"kind\":\"" : "{\"kind\":\"";
+        text += errorKindName(error.kind);
+        text += "\",\"token\":" + to_string(error.tokenIndex);
+        text += ",\"offset\":" + to_string(error.offset);
+        text += ",\"expected\":";
+        if (error.expected == NO_SYMBOL) text += "null";
+        else appendJsonString(text, symbols.name(error.expected));
+        text += ",\"found\":";
+        if (error.found == NO_SYMBOL) text += "null";
+        else appendJsonString(text, symbols.name(error.found));
+        text += "}";
+    }
+    text += "]";
+}
+
+void ResultWriter::writeHeader() {
+    if (format == ResultFormat::Csv) {
+        buffer += "source,line,status,tokens,errors,error_offsets\n";
+    }
+}
+
+void ResultWriter::write(const string& source, int lineNum, const ParseResult& result) {
+    switch (format) {
+        case ResultFormat::Text: {
+            ostringstream line;
+            line << source << ": ";
+            printLineResult(cfg, lineNum, result, line);
+            buffer += line.str();
+            break;
+        }
+        case ResultFormat::Jsonl: {
+            buffer += "{\"source\":";
+            appendJsonString(buffer, source);
+            buffer += ",\"line\":" + to_string(lineNum) + ",";
+            appendJsonResult(buffer, cfg, result);
+            buffer += "}\n";
+            break;
+        }
+        case ResultFormat::Csv: {
+            appendCsvField(buffer, source);
+            buffer += "," + to_string(lineNum);
+            buffer += result.accepted ? ",accepted," : ",rejected,";
+            buffer += to_string(result.tokenCount) + "," + to_string(result.errorCount) + ",";
+            for (size_t i = 0; i < result.errors.size(); i++) {
+                if (i) buffer += ';';
+                buffer += to_string(result.errors[i].offset);
+            }
+            buffer += "\n";
+            break;
+        }
+    }
+    if (buffer.size() >= (1 << 16)) {
+        flush();
+    }
+}
+
+void ResultWriter::flush() {
+    if (!buffer.empty()) {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    out.flush();
+}
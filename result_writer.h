@@ -0,0 +1,45 @@
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+#include <ostream>
+#include <string>
+#include "parser.h"
+
+using namespace std;
+
+enum class ResultFormat {
+    Text,   // coloured verdicts, as parseFile prints them
+    Jsonl,  // one JSON object per line
+    Csv     // header + one row per line
+};
+
+// Formats per line parse results for batch runs. Output is appended to an internal
+// buffer and flushed in large blocks, a line's record is a few dozen bytes.
+class ResultWriter {
+private:
+    const CFG* cfg;
+    ResultFormat format;
+    ostream& out;
+    string buffer;
+
+    static void appendCsvField(string& text, const string& value);
+
+public:
+    ResultWriter(const CFG* grammar, ResultFormat outputFormat, ostream& output);
+    ~ResultWriter() { flush(); }
+
+    // Parses "text", "jsonl" or "csv"
+    static bool parseFormat(const string& name, ResultFormat& format);
+    static const char* errorKindName(ParseErrorKind kind);
+
+    // JSON building blocks, also used by the parse server's responses
+    static void appendJsonString(string& text, const string& value);
+    // "status":...,"tokens":...,"errors":[...] of one result (no braces)
+    static void appendJsonResult(string& text, const CFG* cfg, const ParseResult& result);
+
+    void writeHeader();
+    void write(const string& source, int lineNum, const ParseResult& result);
+    void flush();
+};
+
+#endif // RESULT_WRITER_H
@@ -0,0 +1,296 @@
+#include "sentence_generator.h"
+#include <climits>
+
+static const int UNREACHABLE = INT_MAX / 4;     // can't derive a finite sentence
+
+SentenceGenerator::SentenceGenerator(const CFG& grammar, GeneratorOptions generatorOptions)
+    : cfg(grammar), options(generatorOptions), rng(generatorOptions.seed) {
+    options.targetTokens = max(0, options.targetTokens);
+    analyse();
+}
+
+int SentenceGenerator::productionLength(int production) const {
+    int length = 0;
+    for (SymbolId symbol : cfg.getProductionRhs(production)) {
+        length = min(UNREACHABLE, length + minLength[symbol]);
+    }
+    return length;
+}
+
+// Every rhs symbol but the last is one level deeper than the lhs
+int SentenceGenerator::productionNeed(int production) const {
+    SymbolSpan rhs = cfg.getProductionRhs(production);
+    int need = 0;
+    for (int i = 0; i < rhs.size(); i++) {
+        need = max(need, min(UNREACHABLE, needDepth[rhs[i]] + (i + 1 < rhs.size())));
+    }
+    return need;
+}
+
+int SentenceGenerator::productionReach(int production) const {
+    SymbolSpan rhs = cfg.getProductionRhs(production);
+    int reach = 0;
+    for (int i = 0; i < rhs.size(); i++) {
+        reach = max(reach, reachDepth[rhs[i]] + (i + 1 < rhs.size()));
+    }
+    return min(reach, options.maxDepth);
+}
+
+// Fixed points over the productions, like the FIRST set computation: shortest length,
+// the height of a shortest derivation, least and most depth below each symbol
+void SentenceGenerator::analyse() {
+    const SymbolTable& symbols = cfg.getSymbols();
+    int symbolCount = symbols.size();
+    int productionCount = cfg.getProductionCount();
+
+    productionsOf.assign(symbolCount, {});
+    for (int p = 0; p < productionCount; p++) {
+        productionsOf[cfg.getProduction(p).lhs].push_back(p);
+    }
+    terminals.clear();
+    minLength.assign(symbolCount, UNREACHABLE);
+    minHeight.assign(symbolCount, UNREACHABLE);
+    needDepth.assign(symbolCount, UNREACHABLE);
+    reachDepth.assign(symbolCount, 0);
+    for (SymbolId id = END_MARKER + 1; id < symbolCount; id++) {
+        if (symbols.isTerminal(id)) {
+            terminals.push_back(id);
+            minLength[id] = 1;
+            minHeight[id] = 0;
+            needDepth[id] = 0;
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int p = 0; p < productionCount; p++) {
+            SymbolId lhs = cfg.getProduction(p).lhs;
+            int length = productionLength(p);
+            if (length < minLength[lhs]) {
+                minLength[lhs] = length;
+                changed = true;
+            }
+            int need = productionNeed(p);
+            if (need < needDepth[lhs]) {
+                needDepth[lhs] = need;
+                changed = true;
+            }
+        }
+    }
+
+    // Only over the shortest productions: always taking the lowest of those finishes
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (int p = 0; p < productionCount; p++) {
+            SymbolId lhs = cfg.getProduction(p).lhs;
+            if (minLength[lhs] == UNREACHABLE || productionLength(p) != minLength[lhs]) {
+                continue;
+            }
+            int height = 0;
+            for (SymbolId symbol : cfg.getProductionRhs(p)) {
+                height = max(height, minHeight[symbol]);
+            }
+            if (height + 1 < minHeight[lhs]) {
+                minHeight[lhs] = height + 1;
+                changed = true;
+            }
+        }
+    }
+
+    SymbolId start = cfg.getStartSymbolId();
+    if (start != NO_SYMBOL && needDepth[start] != UNREACHABLE) {
+        options.maxDepth = max(options.maxDepth, needDepth[start]);
+    }
+    options.maxDepth = max(options.maxDepth, options.nestDepth);    // room for the nesting asked for
+
+    // Grows monotonically up to maxDepth, so this ends even for recursive grammars
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (int p = 0; p < productionCount; p++) {
+            SymbolId lhs = cfg.getProduction(p).lhs;
+            if (productionLength(p) == UNREACHABLE) {
+                continue;
+            }
+            int reach = productionReach(p);
+            if (reach > reachDepth[lhs]) {
+                reachDepth[lhs] = reach;
+                changed = true;
+            }
+        }
+    }
+}
+
+int SentenceGenerator::choose(SymbolId nonTerminal, int depth, bool finishing, bool steering) {
+    const vector<int>& productions = productionsOf[nonTerminal];
+    candidates.clear();
+    for (int p : productions) {
+        if (productionLength(p) != UNREACHABLE && depth + productionNeed(p) <= options.maxDepth) {
+            candidates.push_back(p);
+        }
+    }
+    if (candidates.empty()) {
+        // Only when the caller went past maxDepth: the least deep production
+        int best = productions[0];
+        for (int p : productions) {
+            if (productionNeed(p) < productionNeed(best)) best = p;
+        }
+        return best;
+    }
+
+    if (finishing) {
+        int best = candidates[0], bestHeight = UNREACHABLE;
+        for (int p : candidates) {
+            int height = 0;
+            for (SymbolId symbol : cfg.getProductionRhs(p)) {
+                height = max(height, minHeight[symbol]);
+            }
+            if (productionLength(p) < productionLength(best) ||
+                (productionLength(p) == productionLength(best) && height < bestHeight)) {
+                best = p;
+                bestHeight = height;
+            }
+        }
+        return best;
+    }
+
+    if (steering) {
+        // The ones that get closest to nestDepth
+        int best = 0;
+        for (int p : candidates) {
+            best = max(best, min(depth + productionReach(p), options.nestDepth));
+        }
+        candidates.erase(remove_if(candidates.begin(), candidates.end(), [&](int p) {
+            return min(depth + productionReach(p), options.nestDepth) < best;
+        }), candidates.end());
+    } else if (depth == 0) {
+        // The outermost list (PROG -> STMT PROG) goes on while there's room
+        vector<int>::iterator keep = stable_partition(candidates.begin(), candidates.end(), [&](int p) {
+            SymbolSpan rhs = cfg.getProductionRhs(p);
+            return !rhs.empty() && cfg.getSymbols().isNonTerminal(rhs[rhs.size() - 1]);
+        });
+        if (keep != candidates.begin()) {
+            candidates.erase(keep, candidates.end());
+        }
+    }
+    return candidates[rng() % candidates.size()];
+}
+
+void SentenceGenerator::generate(vector<SymbolId>& out, int* depthReached) {
+    SymbolId start = cfg.getStartSymbolId();
+    int deepest = 0;
+    if (start == NO_SYMBOL || minLength[start] == UNREACHABLE) {
+        if (depthReached) *depthReached = 0;
+        return;
+    }
+
+    // pendingLength: fewest terminals the symbols on the stack still add
+    int emitted = 0;
+    long long pendingLength = minLength[start];
+    bool steering = options.nestDepth > 0;
+    stack.clear();
+    stack.push_back({start, 0});
+    while (!stack.empty()) {
+        Pending top = stack.back();
+        stack.pop_back();
+        deepest = max(deepest, top.depth);
+        if (steering && deepest >= options.nestDepth) {
+            steering = false;
+        }
+        bool finishing = !steering && emitted + pendingLength >= options.targetTokens;
+        pendingLength -= minLength[top.symbol];
+
+        if (!cfg.getSymbols().isNonTerminal(top.symbol)) {
+            out.push_back(top.symbol);
+            emitted++;
+            continue;
+        }
+        SymbolSpan rhs = cfg.getProductionRhs(choose(top.symbol, top.depth, finishing, steering));
+        for (int i = rhs.size() - 1; i >= 0; i--) {
+            stack.push_back({rhs[i], i + 1 < rhs.size() ? top.depth + 1 : top.depth});
+            pendingLength += minLength[rhs[i]];
+        }
+    }
+    if (depthReached) *depthReached = deepest;
+}
+
+MutationKind SentenceGenerator::mutate(vector<SymbolId>& sentence) {
+    MutationKind kind = (MutationKind)(rng() % 5);
+    if (sentence.empty() || terminals.empty()) {
+        kind = MutationKind::Insert;
+    }
+    if (terminals.empty()) {
+        return kind;
+    }
+    auto anyTerminal = [&]() { return terminals[rng() % terminals.size()]; };
+
+    if (kind == MutationKind::Swap) {
+        // Two different neighbours, from a random place on
+        size_t count = sentence.size() > 1 ? sentence.size() - 1 : 0;
+        size_t first = count ? rng() % count : 0;
+        bool swapped = false;
+        for (size_t n = 0; n < count && !swapped; n++) {
+            size_t i = (first + n) % count;
+            if (sentence[i] != sentence[i + 1]) {
+                swap(sentence[i], sentence[i + 1]);
+                swapped = true;
+            }
+        }
+        if (swapped) {
+            return kind;
+        }
+        kind = MutationKind::Replace;
+    }
+
+    switch (kind) {
+        case MutationKind::Delete:
+            sentence.erase(sentence.begin() + rng() % sentence.size());
+            break;
+        case MutationKind::Insert:
+            sentence.insert(sentence.begin() + rng() % (sentence.size() + 1), anyTerminal());
+            break;
+        case MutationKind::Replace: {
+            SymbolId& token = sentence[rng() % sentence.size()];
+            SymbolId replacement = anyTerminal();
+            if (terminals.size() > 1) {
+                while (replacement == token) replacement = anyTerminal();
+            }
+            token = replacement;
+            break;
+        }
+        case MutationKind::Truncate:
+            sentence.resize(rng() % sentence.size());
+            break;
+        case MutationKind::Swap:
+            break;
+    }
+    return kind;
+}
+
+string SentenceGenerator::toText(const vector<SymbolId>& sentence) const {
+    const SymbolTable& symbols = cfg.getSymbols();
+    string text;
+    for (size_t i = 0; i < sentence.size(); i++) {
+        if (i) text += ' ';
+        text += symbols.name(sentence[i]);
+    }
+    return text;
+}
+
+int SentenceGenerator::minimumDepth() const {
+    SymbolId start = cfg.getStartSymbolId();
+    return start == NO_SYMBOL ? 0 : needDepth[start];
+}
+
+const char* SentenceGenerator::mutationName(MutationKind kind) {
+    switch (kind) {
+        case MutationKind::Delete: return "delete";
+        case MutationKind::Insert: return "insert";
+        case MutationKind::Replace: return "replace";
+        case MutationKind::Swap: return "swap";
+        case MutationKind::Truncate: return "truncate";
+    }
+    return "unknown";
+}
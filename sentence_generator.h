@@ -0,0 +1,83 @@
+#ifndef SENTENCE_GENERATOR_H
+#define SENTENCE_GENERATOR_H
+
+#include <random>
+#include <string>
+#include <vector>
+#include "CFG.h"
+
+using namespace std;
+
+struct GeneratorOptions {
+    int targetTokens = 20;  // grow the sentence to about this many tokens, then finish it shortest
+    int maxDepth = 64;      // nesting limit, raised to what the grammar needs and to nestDepth
+    int nestDepth = 0;      // steer every sentence down to this depth once (e.g. nested IF blocks)
+    unsigned seed = 42;
+};
+
+enum class MutationKind { Delete, Insert, Replace, Swap, Truncate };
+
+// Random sentences of a grammar, for stress inputs: walks the productions of the CFG
+// as analysed (after LeftRecursion / LeftFactoring) with an explicit stack, so any
+// sentence it emits is in the language.
+//
+// Depth is the number of productions still open around a symbol: a symbol in the last
+// position of a right hand side takes over its parent's depth (nothing of the parent is
+// left on the parser stack), the others are one deeper. So a list like PROG -> STMT PROG
+// stays flat while every IF { PROG } nests by two (STMT in PROG, PROG in IF), and depth
+// tracks the parser's stack height.
+//
+// Until the target length is in reach, the outermost list keeps going and every other
+// choice is uniform among the productions that fit under maxDepth; after that each
+// non-terminal takes its shortest derivation. With nestDepth, the productions that can
+// go deepest win until the sentence has been that deep once.
+class SentenceGenerator {
+private:
+    const CFG& cfg;
+    GeneratorOptions options;
+    mt19937 rng;
+
+    vector<vector<int>> productionsOf;  // non-terminal -> its production indices
+    vector<int> minLength;              // per symbol: fewest terminals it derives
+    vector<int> minHeight;              // per symbol: height of that shortest derivation
+    vector<int> needDepth;              // per symbol: least depth below it to finish
+    vector<int> reachDepth;             // per symbol: most depth below it (capped at maxDepth)
+    vector<SymbolId> terminals;         // all of them, for mutations
+
+    struct Pending {
+        SymbolId symbol;
+        int depth;
+    };
+    vector<Pending> stack;
+    vector<int> candidates;
+
+    // Same measures for a production's right hand side
+    int productionLength(int production) const;
+    int productionNeed(int production) const;
+    int productionReach(int production) const;
+
+    void analyse();
+    int choose(SymbolId nonTerminal, int depth, bool finishing, bool steering);
+
+public:
+    SentenceGenerator(const CFG& grammar, GeneratorOptions generatorOptions = GeneratorOptions());
+
+    // Appends the terminals of one sentence to out. depthReached (if given) gets the
+    // deepest depth any symbol of the derivation was at
+    void generate(vector<SymbolId>& out, int* depthReached = nullptr);
+
+    // Applies one random edit to the sentence (which may be empty) and returns its kind.
+    // The result is usually, not always, outside the language: check with a Parser
+    MutationKind mutate(vector<SymbolId>& sentence);
+
+    // The terminals separated by single spaces, one input line
+    string toText(const vector<SymbolId>& sentence) const;
+
+    // Least maxDepth any sentence of the grammar needs (the effective maxDepth is never lower)
+    int minimumDepth() const;
+    int getMaxDepth() const { return options.maxDepth; }
+
+    static const char* mutationName(MutationKind kind);
+};
+
+#endif // SENTENCE_GENERATOR_H
@@ -0,0 +1,302 @@
+#ifndef STATIC_GRAMMAR_H
+#define STATIC_GRAMMAR_H
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <string_view>
+
+// Grammars declared in C++ and analysed by the compiler. A grammar is a struct with
+//
+//   enum : int { <terminals...>, TERMINALS, <non-terminals...> = TERMINALS, ..., SYMBOLS };
+//   static constexpr const char* terminals[TERMINALS] = { <spellings> };
+//   static constexpr static_grammar::Rule rules[] = { {LHS, {rhs...}}, {LHS, {}} /* ε */ };
+//   static constexpr int start = <start non-terminal>;
+//
+// FIRST, FOLLOW and the LL(1) table are computed by the constexpr functions below (the
+// same algorithms as CFG, minus the left recursion / factoring rewrites, so the grammar
+// has to be LL(1) as written). Validator<G> keeps them in static constexpr storage: no
+// startup work, no heap, and a conflicting grammar fails to compile.
+namespace static_grammar {
+
+const int MAX_RHS = 8;
+const int CELL_ERROR = -1;
+const int CELL_SYNCH = -2;
+
+struct Rule {
+    int lhs;
+    int rhs[MAX_RHS];
+    int length;
+
+    constexpr Rule(int left, std::initializer_list<int> right) : lhs(left), rhs{}, length(0) {
+        for (int symbol : right) {
+            if (length < MAX_RHS) rhs[length] = symbol;
+            length++;    // too long is reported by analyse()
+        }
+    }
+};
+
+template <class G>
+constexpr int ruleCount() { return sizeof(G::rules) / sizeof(G::rules[0]); }
+
+// Everything the parser needs, one column per terminal plus $ (column TERMINALS)
+template <int T, int N>
+struct Tables {
+    bool nullable[N] = {};
+    bool first[N][T] = {};
+    bool follow[N][T + 1] = {};
+    short table[N][T + 1] = {};
+
+    // First conflict found, row -1 if the grammar is LL(1)
+    int conflictRow = -1;
+    int conflictColumn = -1;
+    int conflictFirst = -1;
+    int conflictSecond = -1;
+    int badRule = -1;       // rule with an out of range symbol or rhs longer than MAX_RHS
+};
+
+// FIRST of rhs[from..length) into out, returns whether all of it is nullable
+template <int T, int N>
+constexpr bool firstOfSequence(const Rule& rule, int from, const Tables<T, N>& t, bool (&out)[T]) {
+    for (int i = from; i < rule.length; i++) {
+        int symbol = rule.rhs[i];
+        if (symbol < T) {
+            out[symbol] = true;
+            return false;
+        }
+        for (int a = 0; a < T; a++) {
+            if (t.first[symbol - T][a]) out[a] = true;
+        }
+        if (!t.nullable[symbol - T]) return false;
+    }
+    return true;
+}
+
+template <class G>
+constexpr Tables<G::TERMINALS, G::SYMBOLS - G::TERMINALS> analyse() {
+    constexpr int T = G::TERMINALS;
+    constexpr int N = G::SYMBOLS - G::TERMINALS;
+    constexpr int R = ruleCount<G>();
+    Tables<T, N> t;
+
+    for (int r = 0; r < R; r++) {
+        const Rule& rule = G::rules[r];
+        bool valid = rule.lhs >= T && rule.lhs < G::SYMBOLS && rule.length <= MAX_RHS;
+        for (int i = 0; valid && i < rule.length; i++) {
+            valid = rule.rhs[i] >= 0 && rule.rhs[i] < G::SYMBOLS;
+        }
+        if (!valid) {
+            t.badRule = r;
+            return t;
+        }
+    }
+
+    // Nullable and FIRST, iterated to a fixed point (grammars here are small)
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int r = 0; r < R; r++) {
+            const Rule& rule = G::rules[r];
+            int lhs = rule.lhs - T;
+            bool first[T] = {};
+            bool nullable = firstOfSequence(rule, 0, t, first);
+            for (int a = 0; a < T; a++) {
+                if (first[a] && !t.first[lhs][a]) {
+                    t.first[lhs][a] = true;
+                    changed = true;
+                }
+            }
+            if (nullable && !t.nullable[lhs]) {
+                t.nullable[lhs] = true;
+                changed = true;
+            }
+        }
+    }
+
+    // FOLLOW: whatever can come after each non-terminal occurrence, $ after the start
+    t.follow[G::start - T][T] = true;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int r = 0; r < R; r++) {
+            const Rule& rule = G::rules[r];
+            for (int i = 0; i < rule.length; i++) {
+                if (rule.rhs[i] < T) continue;
+                int symbol = rule.rhs[i] - T;
+                bool trailer[T] = {};
+                bool trailerNullable = firstOfSequence(rule, i + 1, t, trailer);
+                for (int a = 0; a <= T; a++) {
+                    bool add = (a < T && trailer[a]) || (trailerNullable && t.follow[rule.lhs - T][a]);
+                    if (add && !t.follow[symbol][a]) {
+                        t.follow[symbol][a] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Table, conflicts recorded instead of overwritten, then synch cells from FOLLOW
+    for (int n = 0; n < N; n++) {
+        for (int a = 0; a <= T; a++) {
+            t.table[n][a] = CELL_ERROR;
+        }
+    }
+    for (int r = 0; r < R; r++) {
+        const Rule& rule = G::rules[r];
+        int lhs = rule.lhs - T;
+        bool first[T] = {};
+        bool nullable = firstOfSequence(rule, 0, t, first);
+        for (int a = 0; a <= T; a++) {
+            bool predicts = (a < T && first[a]) || (nullable && t.follow[lhs][a]);
+            if (!predicts) continue;
+            if (t.table[lhs][a] != CELL_ERROR) {
+                if (t.conflictRow < 0) {
+                    t.conflictRow = lhs;
+                    t.conflictColumn = a;
+                    t.conflictFirst = t.table[lhs][a];
+                    t.conflictSecond = r;
+                }
+                continue;
+            }
+            t.table[lhs][a] = r;
+        }
+    }
+    for (int n = 0; n < N; n++) {
+        for (int a = 0; a <= T; a++) {
+            if (t.table[n][a] == CELL_ERROR && t.follow[n][a]) {
+                t.table[n][a] = CELL_SYNCH;
+            }
+        }
+    }
+    return t;
+}
+
+// Instantiated with the numbers of a failed check, so they show up in the compiler's
+// error: Row/Column are table coordinates (non-terminal - TERMINALS, terminal or $),
+// First/Second the indices of the two rules in G::rules that both predict that cell
+template <int Row, int Column, int First, int Second>
+struct LL1Conflict {
+    static_assert(Row < 0, "grammar is not LL(1): rules First and Second both predict table[Row][Column]");
+    static constexpr bool ok = true;
+};
+
+template <int Rule>
+struct MalformedRule {
+    static_assert(Rule < 0, "rule has a symbol outside the grammar's enum or more than MAX_RHS symbols");
+    static constexpr bool ok = true;
+};
+
+// capacityExceeded: the line has more than MaxDepth tokens or needs a deeper stack, so
+// it wasn't fully parsed. accepted is false but that says nothing about the input, and
+// errors only counts the syntax errors found before giving up
+struct Result {
+    bool accepted;
+    int errors;
+    bool capacityExceeded = false;
+};
+
+// Parser over the compile-time tables. Parsing state lives on the caller's stack
+// (fixed capacity MaxDepth), nothing is allocated
+template <class G, int MaxDepth = 256>
+class Validator {
+public:
+    static constexpr int T = G::TERMINALS;
+    static constexpr int N = G::SYMBOLS - G::TERMINALS;
+    static constexpr int END = T;       // $ column, what tokens read past the end
+    static constexpr int BOTTOM = G::SYMBOLS;   // $ on the stack
+    static constexpr Tables<T, N> tables = analyse<G>();
+
+private:
+    static_assert(MalformedRule<tables.badRule>::ok, "");
+    static_assert(LL1Conflict<tables.conflictRow, tables.conflictColumn,
+                              tables.conflictFirst, tables.conflictSecond>::ok, "");
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+public:
+    // Terminal for a token's text, -1 if it isn't one
+    static constexpr int lookupTerminal(std::string_view text) {
+        for (int a = 0; a < T; a++) {
+            if (text == G::terminals[a]) return a;
+        }
+        return -1;
+    }
+
+    // Panic mode recovery like Parser: pop on synch or a missing terminal, skip on blank
+    static Result parse(const int* tokens, int count) {
+        std::array<int, MaxDepth> stack;
+        int depth = 0;
+        stack[depth++] = BOTTOM;
+        stack[depth++] = G::start;
+        int pos = 0;
+        int errors = 0;
+        bool recovering = false;
+        auto error = [&]() {
+            if (!recovering) {
+                errors++;
+                recovering = true;
+            }
+        };
+
+        while (depth > 0) {
+            int token = pos < count ? tokens[pos] : END;
+            int top = stack[depth - 1];
+
+            if (top == BOTTOM) {
+                if (token == END) return {errors == 0, errors};
+                error();    // input left after the sentence
+                return {false, errors};
+            }
+            if (top < T) {
+                if (top == token) {
+                    depth--;
+                    pos++;
+                    recovering = false;
+                } else {
+                    error();    // missing terminal, act as if it was there
+                    depth--;
+                }
+                continue;
+            }
+
+            int cell = token < 0 ? CELL_ERROR : tables.table[top - T][token];
+            if (cell >= 0) {
+                const Rule& rule = G::rules[cell];
+                if (depth - 1 + rule.length > MaxDepth) {
+                    return {false, errors, true};
+                }
+                depth--;
+                for (int i = rule.length - 1; i >= 0; i--) {
+                    stack[depth++] = rule.rhs[i];
+                }
+                recovering = false;
+            } else if (cell == CELL_SYNCH || token == END) {
+                error();
+                depth--;
+            } else {
+                error();
+                pos++;
+            }
+        }
+        return {false, errors};
+    }
+
+    // Whitespace separated tokens of one line, more than MaxDepth is capacityExceeded
+    static Result validate(std::string_view line) {
+        std::array<int, MaxDepth> tokens;
+        int count = 0;
+        size_t pos = 0;
+        while (pos < line.size()) {
+            while (pos < line.size() && isSpace(line[pos])) pos++;
+            size_t start = pos;
+            while (pos < line.size() && !isSpace(line[pos])) pos++;
+            if (pos == start) break;
+            if (count == MaxDepth) return {false, 0, true};
+            tokens[count++] = lookupTerminal(line.substr(start, pos - start));
+        }
+        return parse(tokens.data(), count);
+    }
+};
+
+} // namespace static_grammar
+
+#endif // STATIC_GRAMMAR_H
@@ -0,0 +1,191 @@
+#include "stream_parser.h"
+
+static bool isStreamSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+StreamParser::StreamParser(const CFG* grammar, function<void(const StreamEvent&)> callback)
+    : cfg(grammar), onEvent(callback) {
+    reset();
+}
+
+void StreamParser::resynchronize() {
+    parsingStack.clear();
+    parsingStack.push_back(END_MARKER);
+    parsingStack.push_back(cfg->getStartSymbolId());
+}
+
+void StreamParser::reset() {
+    resynchronize();
+    pending.clear();
+    pendingOffset = 0;
+    tokenIndex = 0;
+    line = 1;
+    errorCount = 0;
+    inErrorRecoveryMode = false;
+    finished = false;
+}
+
+void StreamParser::feed(string_view chunk) {
+    if (finished) {
+        return;
+    }
+
+    // Everything up to the last whitespace is complete (terminals never contain
+    // whitespace), the rest might continue in the next chunk
+    size_t cut = chunk.size();
+    while (cut > 0 && !isStreamSpace(chunk[cut - 1])) {
+        cut--;
+    }
+
+    if (cut == 0) {
+        pending.append(chunk.data(), chunk.size());
+        if (pending.size() > MAX_PENDING) {
+            // Pathological input without whitespace, don't let it grow without bound
+            scanSegment(pending, pendingOffset);
+            pendingOffset += pending.size();
+            pending.clear();
+        }
+        return;
+    }
+
+    size_t segmentLength;
+    if (pending.empty()) {
+        scanSegment(chunk.substr(0, cut), pendingOffset);   // straight from the caller's buffer
+        segmentLength = cut;
+    } else {
+        pending.append(chunk.data(), cut);
+        scanSegment(pending, pendingOffset);
+        segmentLength = pending.size();
+    }
+    pendingOffset += segmentLength;
+    pending.assign(chunk.data() + cut, chunk.size() - cut);
+}
+
+void StreamParser::feedTokens(const vector<SymbolId>& tokens) {
+    if (finished) {
+        return;
+    }
+    for (SymbolId token : tokens) {
+        pushToken(token, -1);
+    }
+}
+
+void StreamParser::finish() {
+    if (finished) {
+        return;
+    }
+    if (!pending.empty()) {
+        scanSegment(pending, pendingOffset);
+        pendingOffset += pending.size();
+        pending.clear();
+    }
+    pushToken(END_MARKER, pendingOffset);   // reports UnexpectedEnd if the sentence isn't complete
+    finished = true;
+    StreamEvent done = {errorCount == 0 ? StreamEventKind::Accept : StreamEventKind::Reject,
+                        ParseErrorKind::UnexpectedEnd, tokenIndex, pendingOffset, line, NO_SYMBOL, NO_SYMBOL};
+    onEvent(done);
+}
+
+void StreamParser::scanSegment(string_view text, long long baseOffset) {
+    const SymbolTable& symbols = cfg->getSymbols();
+
+    if (lexer) {
+        lexTokens.clear();
+        lexer->scan(text, lexTokens);
+        size_t cursor = 0;
+        for (const Token& token : lexTokens) {
+            for (; cursor < token.offset; cursor++) {
+                if (text[cursor] == '\n') line++;
+            }
+            pushToken(token.id, baseOffset + token.offset);
+        }
+        for (; cursor < text.size(); cursor++) {
+            if (text[cursor] == '\n') line++;
+        }
+        return;
+    }
+
+    lexTokens.clear();
+    lineEnds.clear();
+    TokenScanner::scan(text, lexTokens, &lineEnds);
+    size_t newlines = 0;
+    for (size_t i = 0; i < lexTokens.size(); i++) {
+        for (; newlines < lineEnds.size() && lineEnds[newlines] <= i; newlines++) line++;
+        const Token& token = lexTokens[i];
+        pushToken(symbols.lookupTerminal(text.substr(token.offset, token.length)), baseOffset + token.offset);
+    }
+    line += lineEnds.size() - newlines;
+}
+
+// One input token through the LL(1) loop: expand until it is matched or skipped, with
+// the same panic mode recovery as Parser::parseLine
+void StreamParser::pushToken(SymbolId token, long long offset) {
+    while (true) {
+        if (parsingStack.empty()) {
+            // Input after an accepted sentence: report it and parse it as a new one
+            reportError(ParseErrorKind::ExtraInput, NO_SYMBOL, token, offset);
+            resynchronize();
+            continue;
+        }
+
+        SymbolId top = parsingStack.back();
+
+        if (top == END_MARKER) {
+            if (token == END_MARKER) {
+                parsingStack.clear();   // Accept
+            } else {
+                // Stray token at the top level (e.g. a '}' too many): skip it and start
+                // over with a new sentence, so the rest of the stream is still checked
+                reportError(ParseErrorKind::ExpectedEnd, top, token, offset);
+                resynchronize();
+            }
+            break;
+        }
+
+        if (cfg->isTerminal(top)) {
+            if (top == token) {
+                parsingStack.pop_back();
+                inErrorRecoveryMode = false;
+                break;
+            }
+            // Panic mode: pretend the expected terminal was there, the token stays. At $
+            // the stream ended before it
+            reportError(token == END_MARKER ? ParseErrorKind::UnexpectedEnd : ParseErrorKind::Mismatch, top,
+                        token, offset);
+            parsingStack.pop_back();
+            continue;
+        }
+
+        int prodIndex = cfg->getParsingTableEntry(top, token);
+        if (prodIndex == TABLE_SYNCH || (prodIndex == TABLE_ERROR && token == END_MARKER)) {
+            // Synchronizing token: drop the non-terminal and retry the token
+            reportError(token == END_MARKER ? ParseErrorKind::UnexpectedEnd : ParseErrorKind::NoEntry, top,
+                        token, offset);
+            parsingStack.pop_back();
+            continue;
+        }
+        if (prodIndex == TABLE_ERROR) {
+            // Skip the token
+            reportError(ParseErrorKind::NoEntry, top, token, offset);
+            break;
+        }
+        parsingStack.pop_back();
+        SymbolSpan production = cfg->getProductionRhs(prodIndex);
+        for (int i = production.size() - 1; i >= 0; i--) {
+            parsingStack.push_back(production[i]);
+        }
+        inErrorRecoveryMode = false;
+    }
+    tokenIndex++;
+}
+
+void StreamParser::reportError(ParseErrorKind kind, SymbolId expected, SymbolId found, long long offset) {
+    if (inErrorRecoveryMode) {
+        return;
+    }
+    inErrorRecoveryMode = true;
+    errorCount++;
+    StreamEvent event = {StreamEventKind::Error, kind, tokenIndex, offset, line, expected, found};
+    onEvent(event);
+}
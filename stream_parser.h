@@ -0,0 +1,79 @@
+#ifndef STREAM_PARSER_H
+#define STREAM_PARSER_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parser.h"
+
+using namespace std;
+
+enum class StreamEventKind {
+    Error,      // a syntax error, reported as soon as the offending token arrives
+    Accept,     // finish(): the whole stream was a valid sentence
+    Reject      // finish(): the stream had errors (Error events were already sent)
+};
+
+struct StreamEvent {
+    StreamEventKind kind;
+    ParseErrorKind error;   // only meaningful for Error
+    long long tokenIndex;   // index of the token in the whole stream
+    long long offset;       // byte offset in the whole stream (-1 for feedToken tokens)
+    int line;               // 1-based line of the token
+    SymbolId expected;
+    SymbolId found;
+};
+
+// Push style LL(1) parser for input that arrives in pieces (e.g. from a socket).
+// Unlike Parser, the whole stream is one sentence of the grammar: the stack lives
+// across feed() calls and newlines are just whitespace, so a statement may span any
+// number of lines or chunks. Memory stays bounded by the nesting depth of the input
+// plus one partially received token; nothing else is buffered. A token that can't
+// continue the sentence at the top level is reported and skipped, and parsing starts
+// over with a new sentence, so a long lived stream keeps being checked.
+class StreamParser {
+private:
+    const CFG* cfg;
+    const Lexer* lexer = nullptr;
+    function<void(const StreamEvent&)> onEvent;
+
+    vector<SymbolId> parsingStack;
+    vector<Token> lexTokens;    // scratch for one chunk
+    vector<uint32_t> lineEnds;  // tokens before each '\n' of the chunk (whitespace splitting)
+    string pending;             // tail of the last chunk that may continue in the next one
+    long long pendingOffset = 0;
+    long long tokenIndex = 0;
+    int line = 1;
+    int errorCount = 0;
+    bool inErrorRecoveryMode = false;
+    bool finished = false;
+
+    void scanSegment(string_view text, long long baseOffset);
+    void pushToken(SymbolId token, long long offset);
+    void resynchronize();       // stack back to [$, start]
+    void reportError(ParseErrorKind kind, SymbolId expected, SymbolId found, long long offset);
+
+public:
+    // Longest run of non-whitespace carried between chunks before it is forced through
+    static const size_t MAX_PENDING = 64 * 1024;
+
+    StreamParser(const CFG* grammar, function<void(const StreamEvent&)> callback);
+
+    // Tokenize with the grammar's DFA lexer instead of whitespace splitting
+    void setLexer(const Lexer* lex) { lexer = lex; }
+
+    // Raw text, may end in the middle of a token
+    void feed(string_view chunk);
+    // Already tokenized input (terminal ids, NO_SYMBOL for unknown tokens)
+    void feedTokens(const vector<SymbolId>& tokens);
+    // End of stream: flushes the pending token, sends $ and the Accept/Reject event
+    void finish();
+    // Start over with a fresh stream
+    void reset();
+
+    int getErrorCount() const { return errorCount; }
+    size_t getStackDepth() const { return parsingStack.size(); }
+};
+
+#endif // STREAM_PARSER_H
@@ -0,0 +1,112 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+using namespace std;
+
+// Every grammar symbol (terminal or non-terminal) is interned once into a
+// dense integer id. The grammar analysis and the parse loop only ever work on
+// these ids, the strings are kept around for printing.
+typedef int SymbolId;
+
+const SymbolId NO_SYMBOL = -1;   // unknown token / empty table cell
+const SymbolId EPSILON = 0;      // "ε"
+const SymbolId END_MARKER = 1;   // "$"
+
+// Non-owning view over a run of symbols (e.g. a production's right hand side
+// inside the CFG's flat rhs pool). Valid as long as the owning CFG is.
+struct SymbolSpan {
+    const SymbolId* first = nullptr;
+    int count = 0;
+
+    const SymbolId* begin() const { return first; }
+    const SymbolId* end() const { return first + count; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    SymbolId operator[](int i) const { return first[i]; }
+};
+
+class SymbolTable {
+private:
+    deque<string> names;    // deque so the string_view keys below never dangle
+    vector<bool> nonTerminal;
+    unordered_map<string_view, SymbolId> ids;
+
+public:
+    SymbolTable() {
+        intern("ε");
+        intern("$");
+    }
+
+    // The map keys point into names, so a copy has to rebuild them for its own strings
+    SymbolTable(const SymbolTable& other) : names(other.names), nonTerminal(other.nonTerminal) {
+        for (size_t id = 0; id < names.size(); id++) {
+            ids.emplace(string_view(names[id]), id);
+        }
+    }
+
+    SymbolTable& operator=(const SymbolTable& other) {
+        if (this != &other) {
+            SymbolTable copy(other);
+            *this = move(copy);
+        }
+        return *this;
+    }
+
+    SymbolTable(SymbolTable&&) = default;               // deque moves keep the strings in place
+    SymbolTable& operator=(SymbolTable&&) = default;
+
+    SymbolId intern(string_view name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        SymbolId id = names.size();
+        names.emplace_back(name);
+        nonTerminal.push_back(false);
+        ids.emplace(string_view(names.back()), id);
+        return id;
+    }
+
+    // Returns NO_SYMBOL if the name was never interned (no allocation)
+    SymbolId lookup(string_view name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? NO_SYMBOL : it->second;
+    }
+
+    // Same as lookup() but only accepts terminals, used for input tokens
+    SymbolId lookupTerminal(string_view name) const {
+        SymbolId id = lookup(name);
+        return isTerminal(id) ? id : NO_SYMBOL;
+    }
+
+    const string& name(SymbolId id) const {
+        static const string unknown = "?";
+        if (id < 0 || id >= (int)names.size()) {
+            return unknown;
+        }
+        return names[id];
+    }
+
+    void setNonTerminal(SymbolId id) {
+        nonTerminal[id] = true;
+    }
+
+    bool isNonTerminal(SymbolId id) const {
+        return id >= 0 && id < (int)nonTerminal.size() && nonTerminal[id];
+    }
+
+    bool isTerminal(SymbolId id) const {
+        return id > EPSILON && id < (int)nonTerminal.size() && !nonTerminal[id];
+    }
+
+    int size() const {
+        return names.size();
+    }
+};
+
+#endif // SYMBOLS_H
@@ -0,0 +1,78 @@
+#ifndef TERMINAL_SET_H
+#define TERMINAL_SET_H
+
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// Fixed size bitset over the terminal alphabet (one bit per parsing table column).
+// Used for FIRST and FOLLOW sets so that merging two sets is a plain word-wide OR
+// the compiler can vectorize, instead of inserting into a set<> one element at a time.
+class TerminalSet {
+private:
+    vector<uint64_t> words;
+
+public:
+    TerminalSet() {}
+
+    explicit TerminalSet(int bits) : words((bits + 63) / 64, 0) {}
+
+    void insert(int bit) {
+        words[bit >> 6] |= uint64_t(1) << (bit & 63);
+    }
+
+    bool contains(int bit) const {
+        return (words[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    // this |= other, returns true if any new bit was added
+    bool unionWith(const TerminalSet& other) {
+        uint64_t added = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            uint64_t merged = words[i] | other.words[i];
+            added |= merged ^ words[i];
+            words[i] = merged;
+        }
+        return added != 0;
+    }
+
+    void clear() {
+        for (auto& word : words) {
+            word = 0;
+        }
+    }
+
+    bool empty() const {
+        for (uint64_t word : words) {
+            if (word) return false;
+        }
+        return true;
+    }
+
+    int count() const {
+        int total = 0;
+        for (uint64_t word : words) {
+            total += __builtin_popcountll(word);
+        }
+        return total;
+    }
+
+    // Raw words, for serializing the set (see GrammarCache)
+    int wordCount() const { return words.size(); }
+    const uint64_t* data() const { return words.data(); }
+    uint64_t* data() { return words.data(); }
+
+    // Calls fn(bit) for every set bit in increasing order
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            uint64_t word = words[i];
+            while (word) {
+                fn(int(i * 64 + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+};
+
+#endif // TERMINAL_SET_H
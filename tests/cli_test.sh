@@ -0,0 +1,38 @@
+#!/bin/sh
+# Command line checks of cfg_parser: inputs that aren't regular files (a FIFO, a pipe
+# through /dev/stdin) must be read, and bad -j values rejected.
+# cli_test.sh path/to/cfg_parser grammar.txt, exit status 1 on the first failure.
+parser=$1
+grammar=$2
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+failed=0
+
+check() {
+    name=$1 expectedStatus=$2 expectedText=$3 status=$4
+    if [ "$status" -ne "$expectedStatus" ] || ! grep -q "$expectedText" "$dir/out"; then
+        printf '\033[31mError: %s: exit %s (expected %s), output:\033[0m\n' "$name" "$status" "$expectedStatus"
+        cat "$dir/out"
+        failed=1
+    else
+        echo "$name: ok"
+    fi
+}
+
+# FIFO with a rejected second line: both lines reported, exit 1
+mkfifo "$dir/input"
+printf 'int x ;\nx = = 1 ;\n' > "$dir/input" &
+"$parser" --no-cache "$grammar" "$dir/input" > "$dir/out" 2>&1
+status=$?
+wait
+check fifo 1 "Line 2: Parsing failed" $status
+
+# Pipe named as /dev/stdin
+printf 'int x ;\n' | "$parser" --no-cache "$grammar" /dev/stdin > "$dir/out" 2>&1
+check stdin-path 0 "Line 1: Parsing successful" $?
+
+# Thread counts with trailing characters are usage errors
+"$parser" --no-cache -j 4abc "$grammar" /dev/null > "$dir/out" 2>&1
+check threads-suffix 2 "Invalid thread count 4abc" $?
+
+exit $failed
@@ -0,0 +1,102 @@
+// Differential check of IncrementalParser: random edits to a document, each one
+// compared against a full parse of the edited text (errors, tokens, checkpoints).
+// incremental_parser_test grammar.txt [edits], exit status 1 on the first mismatch.
+#include <iostream>
+#include <random>
+#include "incremental_parser.h"
+
+using namespace std;
+
+static bool sameErrors(const ParseResult& a, const ParseResult& b) {
+    if (a.accepted != b.accepted || a.errorCount != b.errorCount || a.errors.size() != b.errors.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.errors.size(); i++) {
+        const ParseError& x = a.errors[i];
+        const ParseError& y = b.errors[i];
+        if (x.kind != y.kind || x.tokenIndex != y.tokenIndex || x.offset != y.offset ||
+            x.expected != y.expected || x.found != y.found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameTokens(const vector<Token>& a, const vector<Token>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].id != b[i].id || a[i].offset != b[i].offset || a[i].length != b[i].length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Edits pieced together from statement fragments and stray tokens, so documents keep
+// drifting between valid and broken and the errors move around
+static bool run(const CFG& cfg, const Lexer* lexer, int edits, unsigned seed) {
+    static const char* fragments[] = {
+        "int x ; ", "x = 5 + 1 ; ", "if ( x > 0 ) { ", "} ", "y = 2 ; ", "+ ", ";", "{", " ", "\n",
+        "x", "int", "if ( y < 3 ) { z = 1 ; } ", "==", "z = 3 ;\n",
+    };
+    const int fragmentCount = sizeof(fragments) / sizeof(fragments[0]);
+    mt19937 rng(seed);
+
+    string document = "int x ; ";
+    for (int i = 0; i < 500; i++) {
+        document += fragments[rng() % fragmentCount];
+    }
+    IncrementalParser incremental(&cfg);
+    incremental.setLexer(lexer);
+    incremental.parse(document);
+
+    long long incrementalSteps = 0, fullSteps = 0;
+    for (int edit = 0; edit < edits; edit++) {
+        size_t offset = rng() % (document.size() + 1);
+        size_t removed = rng() % 4 == 0 ? rng() % 8 : 0;
+        string inserted = rng() % 3 == 0 ? "" : fragments[rng() % fragmentCount];
+        document.replace(offset, min(removed, document.size() - offset), inserted);
+
+        const ParseResult& result = incremental.edit(offset, removed, inserted);
+        IncrementalParser full(&cfg);
+        full.setLexer(lexer);
+        const ParseResult& expected = full.parse(document);
+        incrementalSteps += incremental.getStats().steps;
+        fullSteps += full.getStats().steps;
+
+        const char* problem = nullptr;
+        if (incremental.getText() != document) problem = "text";
+        else if (!sameTokens(incremental.getTokens(), full.getTokens())) problem = "tokens";
+        else if (!sameErrors(result, expected)) problem = "errors";
+        else if (incremental.getCheckpointCount() != full.getCheckpointCount()) problem = "checkpoints";
+        if (problem) {
+            cout << "\033[31mError: " << (lexer ? "lexer" : "whitespace") << " edit " << edit << " (offset " << offset
+                 << ", removed " << removed << ", inserted \"" << inserted << "\"): " << problem
+                 << " differ from a full parse\033[0m\n";
+            return false;
+        }
+    }
+    cout << (lexer ? "lexer" : "whitespace") << ": " << edits << " edits match, " << incrementalSteps
+         << " steps incremental vs " << fullSteps << " full\n";
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <grammar file> [edits]\n";
+        return 2;
+    }
+    CFG cfg(argv[1]);
+    cfg.LeftRecursion();
+    cfg.LeftFactoring();
+    cfg.computeFirstSets();
+    cfg.computeFollowSets();
+    cfg.constructParsingTable();
+    Lexer lexer(cfg);
+    int edits = argc > 2 ? atoi(argv[2]) : 3000;
+
+    bool ok = run(cfg, nullptr, edits, 1) && run(cfg, &lexer, edits, 1);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+#include "token_scanner.h"
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TOKEN_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+static bool isScanSpace(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static void scanScalar(string_view text, vector<Token>& out, vector<uint32_t>* lineEnds) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    size_t length = text.size();
+    size_t first = out.size();
+    size_t pos = 0;
+    while (pos < length) {
+        while (pos < length && isScanSpace(bytes[pos])) {
+            if (lineEnds && bytes[pos] == '\n') lineEnds->push_back(out.size() - first);
+            pos++;
+        }
+        size_t start = pos;
+        while (pos < length && !isScanSpace(bytes[pos])) pos++;
+        if (pos > start) {
+            out.push_back({NO_SYMBOL, (uint32_t)start, (uint32_t)(pos - start)});
+        }
+    }
+}
+
+#ifdef TOKEN_SCANNER_X86
+
+// Token boundaries of one 64 byte block from its whitespace / newline masks (bit i =
+// byte i). carry is whether the byte before the block was whitespace. Starts and ends
+// strictly alternate, so the starts append tokens at used and the ends give lengths to
+// them in the same order from open, each in its own branch free loop. tokens has room
+// for 64 more
+__attribute__((always_inline)) static inline void walkBlock(uint64_t space, uint64_t newline, size_t base,
+                                                            uint64_t& carry, Token* tokens, size_t& used, size_t& open,
+                                                            size_t first, vector<uint32_t>* lineEnds) {
+    uint64_t before = (space << 1) | carry;     // bit i: byte i - 1 is whitespace
+    uint64_t starts = ~space & before;
+    uint64_t ends = space & ~before;
+    carry = space >> 63;
+
+    if (lineEnds) {
+        for (uint64_t bits = newline; bits; bits &= bits - 1) {
+            uint64_t below = (1ULL << __builtin_ctzll(bits)) - 1;
+            lineEnds->push_back(used - first + __builtin_popcountll(starts & below));
+        }
+    }
+    for (uint64_t bits = starts; bits; bits &= bits - 1) {
+        tokens[used++] = {NO_SYMBOL, (uint32_t)(base + __builtin_ctzll(bits)), 0};
+    }
+    for (uint64_t bits = ends; bits; bits &= bits - 1) {
+        Token& token = tokens[open++];
+        token.length = base + __builtin_ctzll(bits) - token.offset;
+    }
+}
+
+// Runs the kernel's 64 byte mask function over the text, the tail is copied into a
+// block padded with spaces (which also closes a token running up to the end). Tokens
+// are written through a pointer into out, grown ahead in doubling steps and trimmed
+// at the end. Always inlined so the mask function gets the calling kernel's target
+template <typename MaskFunction>
+__attribute__((always_inline)) static inline void scanBlocks(string_view text, vector<Token>& out,
+                                                             vector<uint32_t>* lineEnds, MaskFunction masks) {
+    const char* data = text.data();
+    size_t length = text.size();
+    size_t first = out.size();
+    size_t used = first, open = first;
+    uint64_t carry = 1;
+    uint64_t space, newline;
+
+    auto room = [&]() {
+        if (used + 64 > out.size()) {
+            out.resize(max(out.size() * 2, used + 64));
+        }
+        return out.data();
+    };
+    size_t base = 0;
+    for (; base + 64 <= length; base += 64) {
+        Token* tokens = room();
+        masks(data + base, space, newline);
+        walkBlock(space, newline, base, carry, tokens, used, open, first, lineEnds);
+    }
+    alignas(64) char tail[64];
+    memset(tail, ' ', sizeof(tail));
+    memcpy(tail, data + base, length - base);
+    Token* tokens = room();
+    masks(tail, space, newline);
+    walkBlock(space, newline, base, carry, tokens, used, open, first, lineEnds);
+    out.resize(used);
+}
+
+// Whitespace is ' ' or 9..13, the latter as (byte - 9) <= 4 unsigned
+__attribute__((always_inline)) static inline void masksSSE2(const char* block, uint64_t& space, uint64_t& newline) {
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    space = newline = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        __m128i control = _mm_sub_epi8(bytes, tab);
+        __m128i isSpace = _mm_or_si128(_mm_cmpeq_epi8(bytes, blank), _mm_cmpeq_epi8(_mm_min_epu8(control, four), control));
+        space |= (uint64_t)(uint16_t)_mm_movemask_epi8(isSpace) << (16 * i);
+        newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, lineFeed)) << (16 * i);
+    }
+}
+
+static void scanSSE2(string_view text, vector<Token>& out, vector<uint32_t>* lineEnds) {
+    scanBlocks(text, out, lineEnds, masksSSE2);
+}
+
+__attribute__((target("avx2"), always_inline)) static inline void masksAVX2(const char* block, uint64_t& space, uint64_t& newline) {
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i lineFeed = _mm256_set1_epi8('\n');
+    space = newline = 0;
+    for (int i = 0; i < 2; i++) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+        __m256i control = _mm256_sub_epi8(bytes, tab);
+        __m256i isSpace = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, blank),
+                                          _mm256_cmpeq_epi8(_mm256_min_epu8(control, four), control));
+        space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(isSpace) << (32 * i);
+        newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, lineFeed)) << (32 * i);
+    }
+}
+
+__attribute__((target("avx2"))) static void scanAVX2(string_view text, vector<Token>& out, vector<uint32_t>* lineEnds) {
+    scanBlocks(text, out, lineEnds, masksAVX2);
+}
+
+#endif // TOKEN_SCANNER_X86
+
+static TokenScanner::KernelFunction kernelFor(ScanKernel kernel) {
+    switch (kernel) {
+#ifdef TOKEN_SCANNER_X86
+        case ScanKernel::AVX2: return scanAVX2;
+        case ScanKernel::SSE2: return scanSSE2;
+#endif
+        default: return scanScalar;
+    }
+}
+
+bool TokenScanner::isSupported(ScanKernel kernel) {
+#ifdef TOKEN_SCANNER_X86
+    __builtin_cpu_init();   // may run before the static constructors did
+    switch (kernel) {
+        case ScanKernel::AVX2: return __builtin_cpu_supports("avx2");
+        case ScanKernel::SSE2: return __builtin_cpu_supports("sse2");
+        default: return true;
+    }
+#else
+    return kernel == ScanKernel::Scalar;
+#endif
+}
+
+ScanKernel TokenScanner::activeKernel() {
+    for (ScanKernel kernel : {ScanKernel::AVX2, ScanKernel::SSE2}) {
+        if (isSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return ScanKernel::Scalar;
+}
+
+const char* TokenScanner::kernelName(ScanKernel kernel) {
+    switch (kernel) {
+        case ScanKernel::AVX2: return "avx2";
+        case ScanKernel::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+void TokenScanner::scan(ScanKernel kernel, string_view text, vector<Token>& out, vector<uint32_t>* lineEnds) {
+    kernelFor(kernel)(text, out, lineEnds);
+}
+
+TokenScanner::KernelFunction TokenScanner::kernelFunction = kernelFor(TokenScanner::activeKernel());
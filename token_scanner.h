@@ -0,0 +1,42 @@
+#ifndef TOKEN_SCANNER_H
+#define TOKEN_SCANNER_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "lexer.h"
+
+using namespace std;
+
+enum class ScanKernel { Scalar, SSE2, AVX2 };
+
+// Whitespace token splitting (the input format without a Lexer). The SIMD kernels
+// classify 16 (SSE2) or 32 (AVX2) bytes per instruction into 64 bit whitespace and
+// newline masks and walk the token boundaries in them with count trailing zeros; the
+// widest kernel the CPU supports is picked on first use. The scalar kernel is the
+// byte loop the parser always had, used on other CPUs. Whitespace is the C locale's
+// isspace: space, \t, \n, \v, \f, \r.
+class TokenScanner {
+public:
+    using KernelFunction = void (*)(string_view, vector<Token>&, vector<uint32_t>*);
+
+    // Appends every token of text to out as {NO_SYMBOL, offset, length} (offsets relative
+    // to text, so text must be under 4 GB). With lineEnds, also appends the number of
+    // tokens in out (counted from the call) before every '\n': the tokens of line i are
+    // [lineEnds[i - 1], lineEnds[i]), all in the same pass
+    static void scan(string_view text, vector<Token>& out, vector<uint32_t>* lineEnds = nullptr) {
+        kernelFunction(text, out, lineEnds);
+    }
+
+    // Same with a given kernel (for benchmarks and cross checks), it must be supported
+    static void scan(ScanKernel kernel, string_view text, vector<Token>& out, vector<uint32_t>* lineEnds = nullptr);
+
+    static bool isSupported(ScanKernel kernel);
+    static ScanKernel activeKernel();
+    static const char* kernelName(ScanKernel kernel);
+
+private:
+    static KernelFunction kernelFunction;   // the active kernel
+};
+
+#endif // TOKEN_SCANNER_H
@@ -0,0 +1,40 @@
+// Grammar compiler: analyses a grammar and writes a specialized parser header.
+// Usage: cfg_codegen grammar.txt generated_parser.h [namespace]
+
+#include <iostream>
+#include <string>
+#include "../CFG.h"
+#include "../codegen.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " <grammar file> <output header> [namespace]" << endl;
+        return 1;
+    }
+    string grammarFile = argv[1];
+    string outputFile = argv[2];
+    string namespaceName = argc > 3 ? argv[3] : "generated_grammar";
+
+    ifstream probe(grammarFile);
+    if (!probe.is_open()) {
+        cout << "\033[31mError: Unable to open grammar file " << grammarFile << "\033[0m" << endl;
+        return 1;
+    }
+    probe.close();
+
+    CFG cfg(grammarFile);
+    cfg.LeftRecursion();
+    cfg.LeftFactoring();
+    cfg.computeFirstSets();
+    cfg.computeFollowSets();
+    cfg.constructParsingTable();
+
+    CodeGenerator generator(cfg);
+    if (!generator.writeFile(outputFile, namespaceName, grammarFile)) {
+        cout << "\033[31mError: Unable to write " << outputFile << "\033[0m" << endl;
+        return 1;
+    }
+    return 0;
+}
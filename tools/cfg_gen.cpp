@@ -0,0 +1,170 @@
+// Stress input generator: random sentences of a grammar, one per line, optionally
+// deeply nested or mutated into invalid ones. Every mutated line is checked with the
+// parser so the invalid ones really are rejected; a summary goes to stderr.
+// Usage: cfg_gen [options] grammar.txt > input.txt
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../grammar_registry.h"
+#include "../sentence_generator.h"
+
+using namespace std;
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options] grammar.txt\n"
+         << "  -n, --lines N        sentences to write (default 1000)\n"
+         << "  -t, --tokens N       target tokens per sentence (default 20)\n"
+         << "  -d, --max-depth N    nesting limit (default 64, or N of --nest)\n"
+         << "      --nest N         take every sentence down to depth N once (nested blocks), N <= -d\n"
+         << "      --invalid F      fraction of mutated, rejected sentences (default 0)\n"
+         << "      --seed N         random seed (default 42)\n"
+         << "      --check          also parse the valid sentences and count mismatches\n"
+         << "  -o, --output PATH    write to a file instead of stdout\n"
+         << "      --no-cache       always analyse the grammar, ignore the .ll1 file\n";
+}
+
+int main(int argc, char* argv[]) {
+    GeneratorOptions options;
+    int lineCount = 1000;
+    double invalidFraction = 0;
+    bool check = false, useCache = true, maxDepthGiven = false;
+    string grammarFile, outputFile;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                cerr << "\033[31mError: " << arg << " needs a value\033[0m" << endl;
+                exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "-n" || arg == "--lines") {
+            lineCount = max(0, atoi(value()));
+        } else if (arg == "-t" || arg == "--tokens") {
+            options.targetTokens = atoi(value());
+        } else if (arg == "-d" || arg == "--max-depth") {
+            options.maxDepth = atoi(value());
+            maxDepthGiven = true;
+        } else if (arg == "--nest") {
+            options.nestDepth = atoi(value());
+        } else if (arg == "--invalid") {
+            invalidFraction = atof(value());
+        } else if (arg == "--seed") {
+            options.seed = strtoul(value(), nullptr, 10);
+        } else if (arg == "--check") {
+            check = true;
+        } else if (arg == "-o" || arg == "--output") {
+            outputFile = value();
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            cerr << "\033[31mError: Unknown option " << arg << "\033[0m" << endl;
+            return 1;
+        } else {
+            grammarFile = arg;
+        }
+    }
+    if (grammarFile.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (maxDepthGiven && options.nestDepth > options.maxDepth) {
+        cerr << "\033[31mError: --nest " << options.nestDepth << " is deeper than --max-depth " << options.maxDepth
+             << "\033[0m" << endl;
+        return 1;
+    }
+
+    GrammarRegistry registry;
+    shared_ptr<const CompiledGrammar> grammar = registry.compile("grammar", grammarFile, useCache);
+    if (!grammar) {
+        cerr << "\033[31mError: Unable to compile grammar " << grammarFile << "\033[0m" << endl;
+        return 1;
+    }
+    if (!grammar->cfg.getConflicts().empty()) {
+        cerr << "\033[33mWarning: " << grammar->cfg.getConflicts().size() << " LL(1) conflict(s) in " << grammarFile
+             << ", the parser may reject valid sentences\033[0m" << endl;
+    }
+
+    ofstream file;
+    if (!outputFile.empty()) {
+        file.open(outputFile);
+        if (!file.is_open()) {
+            cerr << "\033[31mError: Unable to write " << outputFile << "\033[0m" << endl;
+            return 1;
+        }
+    }
+    ostream& out = outputFile.empty() ? cout : file;
+
+    SentenceGenerator generator(grammar->cfg, options);
+    Parser parser = grammar->makeParser();
+    ParseContext context;
+    vector<SymbolId> sentence;
+    string text;
+    long long tokens = 0;
+    int valid = 0, invalid = 0, stillValid = 0, mismatches = 0, deepest = 0, maxStack = 0;
+    int mutations[5] = {};
+    long long errors = 0;
+
+    // Spread the invalid lines evenly: line i is invalid when the running share falls short
+    for (int line = 0; line < lineCount; line++) {
+        sentence.clear();
+        int depth = 0;
+        generator.generate(sentence, &depth);
+        deepest = max(deepest, depth);
+        bool mutate = invalid + stillValid < invalidFraction * (line + 1);
+
+        if (mutate) {
+            // A few more edits if the first ones happen to leave a valid sentence
+            bool rejected = false;
+            int lineErrors = 0;
+            for (int attempt = 0; attempt < 8 && !rejected; attempt++) {
+                mutations[(int)generator.mutate(sentence)]++;
+                text = generator.toText(sentence);
+                const ParseResult& result = parser.parseLine(text, context);
+                rejected = !result.accepted;
+                maxStack = max(maxStack, result.maxStackDepth);
+                lineErrors = result.errorCount;
+            }
+            errors += lineErrors;
+            rejected ? invalid++ : stillValid++;
+        } else {
+            text = generator.toText(sentence);
+            valid++;
+            if (check) {
+                const ParseResult& result = parser.parseLine(text, context);
+                mismatches += !result.accepted;
+                maxStack = max(maxStack, result.maxStackDepth);
+            }
+        }
+        tokens += sentence.size();
+        out << text << '\n';
+    }
+    out.flush();
+
+    cerr << "Generated " << lineCount << " lines, " << tokens << " tokens, depth up to " << deepest
+         << " (limit " << generator.getMaxDepth() << ")" << endl;
+    cerr << "  valid " << valid << ", invalid " << invalid;
+    if (stillValid) cerr << ", mutated but still valid " << stillValid;
+    cerr << endl;
+    if (invalid + stillValid) {
+        cerr << "  mutations:";
+        for (int kind = 0; kind < 5; kind++) {
+            cerr << " " << SentenceGenerator::mutationName((MutationKind)kind) << " " << mutations[kind];
+        }
+        cerr << ", " << errors << " parse errors" << endl;
+    }
+    if (check || invalid + stillValid) {
+        cerr << "  parser stack up to " << maxStack << endl;
+    }
+    if (check && mismatches) {
+        cerr << "\033[31mError: " << mismatches << " generated sentences were rejected\033[0m" << endl;
+        return 1;
+    }
+    return 0;
+}
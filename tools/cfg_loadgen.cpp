@@ -0,0 +1,232 @@
+// Load generator for cfg_server: cycles through the lines of an input file, each
+// connection keeping a window of requests in flight, and reports throughput and the
+// latency percentiles (request written -> response read).
+// Usage: cfg_loadgen [options] input.txt
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct LoadOptions {
+    string socketPath = "/tmp/cfg_parser.sock";
+    string grammar = "grammar";
+    int connections = 4;
+    long long requests = 100000;    // over all connections
+    int window = 32;                // requests in flight per connection
+    string inputFile;
+};
+
+struct ConnectionStats {
+    vector<double> latenciesUs;
+    long long accepted = 0;
+    long long rejected = 0;
+    long long errors = 0;
+    bool failed = false;
+};
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options] input.txt\n"
+         << "  -s, --socket PATH       server socket (default /tmp/cfg_parser.sock)\n"
+         << "  -g, --grammar NAME      grammar to parse with (default grammar)\n"
+         << "  -c, --connections N     concurrent connections (default 4)\n"
+         << "  -n, --requests N        total requests (default 100000)\n"
+         << "  -w, --window N          requests in flight per connection (default 32)\n";
+}
+
+static int connectTo(const string& path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static bool sendAll(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// One connection: the request ids are indexes into this connection's send times, the
+// server may answer a window out of order so responses are matched by id
+static void runConnection(const LoadOptions& options, const vector<string>& lines, long long count,
+                          size_t firstLine, ConnectionStats& stats) {
+    int fd = connectTo(options.socketPath);
+    if (fd < 0) {
+        cerr << "\033[31mError: Unable to connect to " << options.socketPath << ": " << strerror(errno) << "\033[0m" << endl;
+        stats.failed = true;
+        return;
+    }
+    vector<Clock::time_point> sentAt(count);
+    stats.latenciesUs.reserve(count);
+    long long sent = 0, done = 0;
+    string out, pending;
+    char chunk[1 << 16];
+
+    while (done < count) {
+        out.clear();
+        Clock::time_point now = Clock::now();
+        while (sent < count && sent - done < options.window) {
+            out += to_string(sent) + " " + options.grammar + " " + lines[(firstLine + sent) % lines.size()] + "\n";
+            sentAt[sent++] = now;
+        }
+        if (!out.empty() && !sendAll(fd, out)) {
+            break;
+        }
+
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        Clock::time_point received = Clock::now();
+        pending.append(chunk, n);
+        size_t start = 0, end;
+        while ((end = pending.find('\n', start)) != string::npos) {
+            string_view response(pending.data() + start, end - start);
+            start = end + 1;
+            // {"id":"<n>",...
+            long long id = response.size() > 7 ? atoll(response.data() + 7) : -1;
+            if (id < 0 || id >= sent) {
+                cerr << "\033[31mError: Unexpected response " << response << "\033[0m" << endl;
+                stats.failed = true;
+                close(fd);
+                return;
+            }
+            stats.latenciesUs.push_back(chrono::duration<double, micro>(received - sentAt[id]).count());
+            if (response.find("\"status\":\"accepted\"") != string_view::npos) stats.accepted++;
+            else if (response.find("\"status\":\"rejected\"") != string_view::npos) stats.rejected++;
+            else stats.errors++;
+            done++;
+        }
+        pending.erase(0, start);
+    }
+    if (done < count) {
+        cerr << "\033[31mError: Connection closed after " << done << " of " << count << " responses\033[0m" << endl;
+        stats.failed = true;
+    }
+    close(fd);
+}
+
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index];
+}
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                cerr << "\033[31mError: " << arg << " needs a value\033[0m" << endl;
+                exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "-s" || arg == "--socket") {
+            options.socketPath = value();
+        } else if (arg == "-g" || arg == "--grammar") {
+            options.grammar = value();
+        } else if (arg == "-c" || arg == "--connections") {
+            options.connections = max(1, atoi(value()));
+        } else if (arg == "-n" || arg == "--requests") {
+            options.requests = max(1LL, atoll(value()));
+        } else if (arg == "-w" || arg == "--window") {
+            options.window = max(1, atoi(value()));
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            cerr << "\033[31mError: Unknown option " << arg << "\033[0m" << endl;
+            return 1;
+        } else {
+            options.inputFile = arg;
+        }
+    }
+    if (options.inputFile.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    ifstream input(options.inputFile);
+    if (!input.is_open()) {
+        cerr << "\033[31mError: Unable to open input file " << options.inputFile << "\033[0m" << endl;
+        return 1;
+    }
+    vector<string> lines;
+    string line;
+    while (getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) lines.push_back(line);
+    }
+    if (lines.empty()) {
+        cerr << "\033[31mError: " << options.inputFile << " has no non empty lines\033[0m" << endl;
+        return 1;
+    }
+
+    vector<ConnectionStats> stats(options.connections);
+    vector<thread> threads;
+    Clock::time_point start = Clock::now();
+    for (int c = 0; c < options.connections; c++) {
+        long long count = options.requests / options.connections + (c < options.requests % options.connections);
+        size_t firstLine = (size_t)c * lines.size() / options.connections;
+        threads.emplace_back(runConnection, cref(options), cref(lines), count, firstLine, ref(stats[c]));
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    ConnectionStats total;
+    for (ConnectionStats& s : stats) {
+        total.latenciesUs.insert(total.latenciesUs.end(), s.latenciesUs.begin(), s.latenciesUs.end());
+        total.accepted += s.accepted;
+        total.rejected += s.rejected;
+        total.errors += s.errors;
+        total.failed |= s.failed;
+    }
+    sort(total.latenciesUs.begin(), total.latenciesUs.end());
+
+    cout << fixed << setprecision(1);
+    cout << "Requests:    " << total.latenciesUs.size() << " over " << options.connections << " connections, window "
+         << options.window << "\n";
+    cout << "Throughput:  " << total.latenciesUs.size() / seconds << " req/s (" << seconds << " s)\n";
+    cout << "Results:     " << total.accepted << " accepted, " << total.rejected << " rejected, " << total.errors
+         << " errors\n";
+    cout << "Latency us:  p50 " << percentile(total.latenciesUs, 0.50) << "  p90 " << percentile(total.latenciesUs, 0.90)
+         << "  p99 " << percentile(total.latenciesUs, 0.99) << "  p99.9 " << percentile(total.latenciesUs, 0.999)
+         << "  max " << (total.latenciesUs.empty() ? 0.0 : total.latenciesUs.back()) << endl;
+    return total.failed ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+// Parse server: compiles the grammars once and answers requests on a Unix socket until
+// SIGINT / SIGTERM. SIGHUP recompiles every grammar from its file.
+// Usage: cfg_server [options] [name=]grammar.txt ...   (name defaults to the file stem)
+
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "../grammar_registry.h"
+#include "../metrics.h"
+#include "../parse_server.h"
+
+using namespace std;
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options] [name=]grammar.txt ...\n"
+         << "  -s, --socket PATH    socket to listen on (default /tmp/cfg_parser.sock)\n"
+         << "  -j, --threads N      worker threads (default: hardware threads)\n"
+         << "  -b, --batch N        requests a worker takes at once (default 64)\n"
+         << "      --no-cache       always analyse the grammars, ignore .ll1 files\n"
+         << "      --metrics json|prometheus write metrics to stderr on exit\n";
+}
+
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+    bool useCache = true;
+    string metricsFormat;
+    vector<pair<string, string>> grammars;     // name, file
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&](string& out) {
+            if (i + 1 >= argc) {
+                cerr << "\033[31mError: " << arg << " needs a value\033[0m" << endl;
+                return false;
+            }
+            out = argv[++i];
+            return true;
+        };
+        string text;
+        if (arg == "-s" || arg == "--socket") {
+            if (!value(options.socketPath)) return 1;
+        } else if (arg == "-j" || arg == "--threads") {
+            if (!value(text)) return 1;
+            options.threads = atoi(text.c_str());
+        } else if (arg == "-b" || arg == "--batch") {
+            if (!value(text)) return 1;
+            options.maxBatch = atoi(text.c_str());
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg == "--metrics") {
+            if (!value(metricsFormat)) return 1;
+            if (metricsFormat != "json" && metricsFormat != "prometheus") {
+                cerr << "\033[31mError: Unknown metrics format " << metricsFormat << "\033[0m" << endl;
+                return 1;
+            }
+#ifdef CFG_NO_METRICS
+            cerr << "\033[33mWarning: built with CFG_METRICS=OFF, --metrics will write no measurements\033[0m" << endl;
+#endif
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            cerr << "\033[31mError: Unknown option " << arg << "\033[0m" << endl;
+            return 1;
+        } else {
+            size_t equals = arg.find('=');
+            if (equals != string::npos) {
+                grammars.push_back({arg.substr(0, equals), arg.substr(equals + 1)});
+            } else {
+                size_t slash = arg.find_last_of('/');
+                string stem = slash == string::npos ? arg : arg.substr(slash + 1);
+                grammars.push_back({stem.substr(0, stem.find('.')), arg});
+            }
+        }
+    }
+    if (grammars.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!metricsFormat.empty()) {
+        Metrics::enable();
+    }
+
+    GrammarRegistry registry;
+    for (const auto& grammar : grammars) {
+        if (!registry.load(grammar.first, grammar.second, useCache)) {
+            cerr << "\033[31mError: Unable to compile grammar " << grammar.second << "\033[0m" << endl;
+            return 1;
+        }
+        cerr << "Loaded " << grammar.first << " from " << grammar.second << endl;
+    }
+
+    // Blocked before start() so every server thread inherits the mask and the signals
+    // only ever reach the sigwait below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    ParseServer server(registry, options);
+    if (!server.start()) {
+        return 1;
+    }
+    cerr << "Listening on " << options.socketPath << endl;
+
+    while (true) {
+        int signal = 0;
+        if (sigwait(&signals, &signal) != 0) {
+            continue;
+        }
+        if (signal != SIGHUP) {
+            break;
+        }
+        // Parses in flight finish on the version they started with
+        for (const auto& grammar : grammars) {
+            if (registry.reload(grammar.first, useCache)) {
+                cerr << "Reloaded " << grammar.first << endl;
+            } else {
+                cerr << "\033[31mError: Unable to reload " << grammar.first << ", keeping the old version\033[0m" << endl;
+            }
+        }
+    }
+
+    server.stop();
+    if (Metrics::enabled()) {
+        cerr << (metricsFormat == "prometheus" ? Metrics::global().toPrometheus() : Metrics::global().toJson() + "\n");
+    }
+    return 0;
+}
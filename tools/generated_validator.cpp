@@ -0,0 +1,48 @@
+// Line validator built on the parser generated from grammar.txt at build time.
+// Usage: cfg_generated input.txt [--quiet]
+// Prints the same per line verdicts as cfg_parser with trace off.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../mapped_file.h"
+#include "generated_parser.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cout << "Usage: " << argv[0] << " <input file> [--quiet]" << endl;
+        return 1;
+    }
+    bool quiet = argc > 2 && string(argv[2]) == "--quiet";
+
+    MappedFile input;
+    if (!input.open(argv[1])) {
+        cout << "\033[31mError: Unable to open input file " << argv[1] << "\033[0m" << endl;
+        return 1;
+    }
+
+    vector<int> tokens;
+    vector<int> stack;
+    int accepted = 0;
+    int rejected = 0;
+    forEachLine(input.view(), [&](string_view line, int lineNum) {
+        generated_grammar::Result result = generated_grammar::validate(line, tokens, stack);
+        if (result.accepted) {
+            accepted++;
+        } else {
+            rejected++;
+        }
+        if (!quiet) {
+            if (result.accepted) {
+                cout << "\033[32mLine " << lineNum << ": accepted\033[0m" << endl;
+            } else {
+                cout << "\033[31mLine " << lineNum << ": rejected (" << result.errors << " errors)\033[0m" << endl;
+            }
+        }
+    });
+
+    cout << accepted << " accepted, " << rejected << " rejected" << endl;
+    return 0;
+}
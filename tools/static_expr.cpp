@@ -0,0 +1,72 @@
+// The EXPR / EXPR_TAIL / TERM part of grammar.txt declared with static_grammar.h.
+// Usage: cfg_static_expr [file]   (stdin without a file)
+// Prints one verdict per line; all grammar analysis happened at compile time.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "../static_grammar.h"
+
+using namespace std;
+using static_grammar::Rule;
+
+struct ExprGrammar {
+    enum : int {
+        PLUS, MINUS, X, Y, Z, D0, D1, D2, D3, D4, D5, D6, D7, D8, D9,
+        TERMINALS,
+        EXPR = TERMINALS, EXPR_TAIL, TERM, ID, NUM,
+        SYMBOLS
+    };
+
+    static constexpr const char* terminals[TERMINALS] = {
+        "+", "-", "x", "y", "z", "0", "1", "2", "3", "4", "5", "6", "7", "8", "9",
+    };
+
+    static constexpr Rule rules[] = {
+        {EXPR, {TERM, EXPR_TAIL}},
+        {EXPR_TAIL, {PLUS, TERM, EXPR_TAIL}},
+        {EXPR_TAIL, {MINUS, TERM, EXPR_TAIL}},
+        {EXPR_TAIL, {}},
+        {TERM, {ID}},
+        {TERM, {NUM}},
+        {ID, {X}}, {ID, {Y}}, {ID, {Z}},
+        {NUM, {D0}}, {NUM, {D1}}, {NUM, {D2}}, {NUM, {D3}}, {NUM, {D4}},
+        {NUM, {D5}}, {NUM, {D6}}, {NUM, {D7}}, {NUM, {D8}}, {NUM, {D9}},
+    };
+
+    static constexpr int start = EXPR;
+};
+
+using ExprValidator = static_grammar::Validator<ExprGrammar>;
+
+// A few facts the compiler has to agree with
+static_assert(ExprValidator::tables.nullable[ExprGrammar::EXPR_TAIL - ExprGrammar::TERMINALS], "");
+static_assert(ExprValidator::tables.table[ExprGrammar::EXPR - ExprGrammar::TERMINALS][ExprGrammar::X] == 0, "");
+static_assert(ExprValidator::lookupTerminal("-") == ExprGrammar::MINUS, "");
+
+int main(int argc, char* argv[]) {
+    ifstream file;
+    if (argc > 1) {
+        file.open(argv[1]);
+        if (!file.is_open()) {
+            cout << "\033[31mError: Unable to open input file " << argv[1] << "\033[0m" << endl;
+            return 1;
+        }
+    }
+    istream& input = argc > 1 ? file : cin;
+
+    string line;
+    int lineNum = 0;
+    while (getline(input, line)) {
+        lineNum++;
+        static_grammar::Result result = ExprValidator::validate(line);
+        if (result.accepted) {
+            cout << "\033[32mLine " << lineNum << ": accepted\033[0m" << endl;
+        } else if (result.capacityExceeded) {
+            cout << "\033[33mLine " << lineNum << ": too long or too deeply nested to validate\033[0m" << endl;
+        } else {
+            cout << "\033[31mLine " << lineNum << ": rejected (" << result.errors << " errors)\033[0m" << endl;
+        }
+    }
+    return 0;
+}
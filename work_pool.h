@@ -0,0 +1,101 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Small work stealing loop for embarrassingly parallel jobs (e.g. one task per chunk
+// of input lines). Every worker starts with an equal contiguous range of items and
+// takes them from the front. A worker that runs dry steals the back half of the
+// busiest looking victim's remaining range, so uneven lines still balance out.
+class WorkPool {
+private:
+    struct Range {
+        mutex lock;
+        int next = 0;
+        int end = 0;
+    };
+
+    // Take one item from our own range, -1 if it's empty
+    static int takeOwn(Range& range) {
+        lock_guard<mutex> guard(range.lock);
+        return range.next < range.end ? range.next++ : -1;
+    }
+
+    // Move the upper half of some other worker's range into ours
+    static bool steal(vector<Range>& ranges, int self) {
+        int workers = ranges.size();
+        for (int i = 1; i < workers; i++) {
+            Range& victim = ranges[(self + i) % workers];
+            int from, to;
+            {
+                lock_guard<mutex> guard(victim.lock);
+                int remaining = victim.end - victim.next;
+                if (remaining <= 0) {
+                    continue;
+                }
+                int half = (remaining + 1) / 2;
+                to = victim.end;
+                from = victim.end - half;
+                victim.end = from;
+            }
+            lock_guard<mutex> guard(ranges[self].lock);
+            ranges[self].next = from;
+            ranges[self].end = to;
+            return true;
+        }
+        return false;
+    }
+
+public:
+    static int defaultThreads() {
+        int count = thread::hardware_concurrency();
+        return count > 0 ? count : 1;
+    }
+
+    // Calls task(worker, item) for every item in [0, itemCount). worker is in
+    // [0, threads) so callers can keep per-thread state without locking.
+    template <typename Fn>
+    static void run(int itemCount, int threads, Fn task) {
+        threads = max(1, min(threads, itemCount));
+        if (threads == 1) {
+            for (int item = 0; item < itemCount; item++) {
+                task(0, item);
+            }
+            return;
+        }
+
+        vector<Range> ranges(threads);
+        for (int w = 0; w < threads; w++) {
+            ranges[w].next = (long long)itemCount * w / threads;
+            ranges[w].end = (long long)itemCount * (w + 1) / threads;
+        }
+
+        auto worker = [&](int self) {
+            while (true) {
+                int item = takeOwn(ranges[self]);
+                if (item < 0) {
+                    if (!steal(ranges, self)) {
+                        return;
+                    }
+                    continue;
+                }
+                task(self, item);
+            }
+        };
+
+        vector<thread> pool;
+        for (int w = 1; w < threads; w++) {
+            pool.emplace_back(worker, w);
+        }
+        worker(0);
+        for (auto& t : pool) {
+            t.join();
+        }
+    }
+};
+
+#endif // WORK_POOL_H